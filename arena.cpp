@@ -0,0 +1,46 @@
+//
+//  Framework for a raytracer
+//  File: arena.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "arena.h"
+#include <stdint.h>
+
+/************************** Arena **********************************/
+
+Arena::~Arena()
+{
+    // in reverse, objects may refer to the ones created before them
+    for (size_t i = destructors.size(); i > 0; i--) {
+        destructors[i - 1].destroy(destructors[i - 1].obj);
+    }
+    for (size_t i = 0; i < blocks.size(); i++) {
+        delete[] blocks[i];
+    }
+}
+
+void* Arena::allocate(size_t size, size_t align)
+{
+    uintptr_t p = ((uintptr_t)next + align - 1) & ~(uintptr_t)(align - 1);
+    if (!next || p + size > (uintptr_t)end) {
+        // objects larger than a block get a block of their own
+        size_t length = size + align > blockSize ? size + align : blockSize;
+        blocks.push_back(new char[length]);
+        next = blocks.back();
+        end = next + length;
+        p = ((uintptr_t)next + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    next = (char*)(p + size);
+    used += size;
+    return (void*)p;
+}
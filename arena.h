@@ -0,0 +1,75 @@
+//
+//  Framework for a raytracer
+//  File: arena.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Storage of the objects, materials, textures and lights of a scene. They
+// are placed one after the other in large blocks, in the order they are
+// read, and are all freed with the arena. Only the objects whose
+// destructor does something (meshes, textures) are remembered to be
+// destroyed, so a scene of plain primitives is freed a block at a time.
+class Arena
+{
+public:
+    Arena() : next(NULL), end(NULL), used(0) { }
+    ~Arena();
+
+    template <class T, class... Args>
+    T* create(Args&&... args)
+    {
+        T *obj = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value) {
+            destructors.push_back(Destructor(obj, &Arena::destroy<T>));
+        }
+        return obj;
+    }
+
+    void* allocate(size_t size, size_t align);
+
+    // bytes given out so far
+    size_t size() const { return used; }
+
+private:
+    static const size_t blockSize = 64 * 1024;
+
+    template <class T>
+    static void destroy(void *obj) { static_cast<T*>(obj)->~T(); }
+
+    class Destructor
+    {
+    public:
+        Destructor(void *obj, void (*destroy)(void *)) : obj(obj), destroy(destroy) { }
+
+        void *obj;
+        void (*destroy)(void *);
+    };
+
+    Arena(const Arena &);
+    Arena& operator=(const Arena &);
+
+    std::vector<char*> blocks;
+    char *next, *end;   // free space of the last block
+    size_t used;
+    std::vector<Destructor> destructors;
+};
+
+#endif /* end of include guard: ARENA_H */
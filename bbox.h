@@ -0,0 +1,114 @@
+//
+//  Framework for a raytracer
+//  File: bbox.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef BBOX_H
+#define BBOX_H
+
+#include <algorithm>
+#include <limits>
+#include "triple.h"
+#include "light.h"
+
+// Axis aligned bounding box. A default constructed box is empty, and
+// infinite() is used by objects that have no finite extent (planes).
+class BBox
+{
+public:
+    BBox()
+        : min(std::numeric_limits<double>::infinity(),
+              std::numeric_limits<double>::infinity(),
+              std::numeric_limits<double>::infinity()),
+          max(-std::numeric_limits<double>::infinity(),
+              -std::numeric_limits<double>::infinity(),
+              -std::numeric_limits<double>::infinity())
+    { }
+
+    BBox(const Point &a, const Point &b) : min(a), max(a)
+    {
+        extend(b);
+    }
+
+    static BBox infinite()
+    {
+        BBox box;
+        std::swap(box.min, box.max);
+        return box;
+    }
+
+    void extend(const Point &p)
+    {
+        if (p.x < min.x) min.x = p.x;
+        if (p.y < min.y) min.y = p.y;
+        if (p.z < min.z) min.z = p.z;
+        if (p.x > max.x) max.x = p.x;
+        if (p.y > max.y) max.y = p.y;
+        if (p.z > max.z) max.z = p.z;
+    }
+
+    void extend(const BBox &b)
+    {
+        extend(b.min);
+        extend(b.max);
+    }
+
+    bool isFinite() const
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            if (!(fabs(min.data[i]) < std::numeric_limits<double>::infinity()) ||
+                !(fabs(max.data[i]) < std::numeric_limits<double>::infinity()))
+                return false;
+        }
+        return true;
+    }
+
+    Point centroid() const { return (min + max) * 0.5; }
+
+    double area() const
+    {
+        Vector d = max - min;
+        if (d.x < 0 || d.y < 0 || d.z < 0) return 0;
+        return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    int longestAxis() const
+    {
+        Vector d = max - min;
+        if (d.x > d.y && d.x > d.z) return 0;
+        return d.y > d.z ? 1 : 2;
+    }
+
+    // Slab test, invD is the componentwise inverse of the ray direction.
+    // NaNs coming from 0 * inf are ignored by the comparisons.
+    bool intersect(const Ray &ray, const Vector &invD, double tMax, double &tNear) const
+    {
+        double t0 = 0, t1 = tMax;
+        for (int i = 0; i < 3; i++)
+        {
+            double tA = (min.data[i] - ray.O.data[i]) * invD.data[i];
+            double tB = (max.data[i] - ray.O.data[i]) * invD.data[i];
+            if (tA > tB) std::swap(tA, tB);
+            if (tA > t0) t0 = tA;
+            if (tB < t1) t1 = tB;
+            if (t0 > t1) return false;
+        }
+        tNear = t0;
+        return true;
+    }
+
+    Point min, max;
+};
+
+#endif /* end of include guard: BBOX_H */
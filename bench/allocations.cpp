@@ -0,0 +1,97 @@
+//
+//  Framework for a raytracer
+//  File: allocations.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+// Checks that rendering doesn't allocate memory: every buffer of a render
+// is set up by Raytracer::prepare before its first ray. Every bench scene
+// is rendered on one thread with its own settings, then once with each of
+// the render modes below turned on, e.g. from the repository root:
+//
+//     ./rayalloc
+//
+// The exit status is 1 when a render allocated memory.
+
+#include "benchscenes.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Every heap allocation goes through here, so the renders can be checked
+static std::atomic<unsigned long> allocations(0);
+
+void* operator new(std::size_t size)
+{
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, std::size_t) noexcept { free(p); }
+void operator delete[](void *p, std::size_t) noexcept { free(p); }
+
+// Renders the bench scene name with setting added, false when it couldn't
+// be read. allocated is the number of allocations of the render.
+bool countAllocations(const std::string &name, const std::string &setting, unsigned long &allocated)
+{
+    Raytracer raytracer;
+    if (!readBenchScene(raytracer, name, setting)) return false;
+
+    raytracer.prepare();
+    Image img(raytracer.imageWidth(), raytracer.imageHeight());
+    Silence silence;
+    unsigned long before = allocations;
+    raytracer.render(img);
+    allocated = allocations - before;
+    return true;
+}
+
+int main()
+{
+    // settings added at the end of the scene, the first one renders it as is
+    const char *modes[] = {
+        "", "AdaptiveAA: true", "Wavefront: true", "Deferred: true",
+        "Packets: true", "TextureFilter: trilinear"
+    };
+
+    bool allocating = false;
+    for (unsigned int i = 0; i < numBenchScenes; i++)
+    {
+        for (unsigned int j = 0; j < 6; j++)
+        {
+            std::string mode = modes[j];
+            unsigned long allocated = 0;
+            if (!countAllocations(benchScenes[i], mode, allocated)) return 1;
+
+            std::string name = benchScenes[i] + (mode.empty() ? std::string() : " (" + mode + ")");
+            if (allocated > 0)
+            {
+                cout << name << ": allocated memory " << allocated << " times" << endl;
+                allocating = true;
+            }
+            else
+            {
+                cout << name << ": ok" << endl;
+            }
+        }
+    }
+    return allocating ? 1 : 0;
+}
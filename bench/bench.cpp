@@ -0,0 +1,314 @@
+//
+//  Framework for a raytracer
+//  File: bench.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+// Benchmarks of the raytracer. The micro benchmarks run the intersection
+// tests of every primitive and the phong model over batches of generated
+// rays, the macro benchmarks render the shipped scenes on one thread. Each
+// result is the best of a few runs, given in millions of rays per second,
+// and can be written as JSON and compared to a baseline. The numbers only
+// mean something on the machine and build that recorded them, so the
+// baseline is kept out of the repository: record it before a change and
+// compare after it, from the repository root:
+//
+//     ./raybench -o bench/baseline.json       (make bench-baseline)
+//     ./raybench -b bench/baseline.json       (make bench)
+//
+// The exit status is 1 when a result is slower than the baseline by more
+// than the tolerance, 30% by default, above the noise between runs. That
+// renders don't allocate is checked by rayalloc, see allocations.cpp.
+
+#include "benchscenes.h"
+#include "../sphere.h"
+#include "../triangle.h"
+#include "../plane.h"
+#include "../quad.h"
+#include "../mesh.h"
+#include "../stats.h"
+#include "../generator.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+class Result
+{
+public:
+    Result(const std::string &group, const std::string &name, double mrays)
+        : group(group), name(name), mrays(mrays)
+    { }
+
+    std::string group, name;
+    double mrays;
+};
+
+/************************** Micro benchmarks **********************************/
+
+// Rays starting at distance 4 from the origin and aimed at points of the
+// unit cube around it, so roughly half of them hit the primitives below
+std::vector<Ray> makeRays(unsigned int count, unsigned int seed)
+{
+    Random random(seed);
+    std::vector<Ray> rays;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        Point origin = 4 * random.direction();
+        Point target(random() - 0.5, random() - 0.5, random() - 0.5);
+        rays.push_back(Ray(origin, (target - origin).normalized()));
+    }
+    return rays;
+}
+
+class IntersectKernel
+{
+public:
+    IntersectKernel(Object &object, const std::vector<Ray> &rays) : object(object), rays(rays), hits(0) { }
+
+    void operator()()
+    {
+        for (unsigned int i = 0; i < rays.size(); i++)
+        {
+            if (!object.intersect(rays[i]).no_hit) hits++;
+        }
+    }
+
+    Object &object;
+    const std::vector<Ray> &rays;
+    unsigned long long hits;    // keeps the compiler from dropping the tests
+};
+
+class PhongKernel
+{
+public:
+    PhongKernel(const std::vector<Ray> &rays) : rays(rays), sum(0)
+    {
+        material.color = Color(1, 1, 1);
+        material.ka = 0.2;
+        material.kd = 0.7;
+        material.ks = 0.5;
+        material.n = 32;
+    }
+
+    // the rays give the hit points, normals and view vectors
+    void operator()()
+    {
+        Point light(-2, 5, 3);
+        for (unsigned int i = 0; i < rays.size(); i++)
+        {
+            float diffuse, specular;
+            Scene::phong(rays[i].O, light, -rays[i].D, rays[i].D, &material, diffuse, specular);
+            sum += diffuse + specular;
+        }
+    }
+
+    const std::vector<Ray> &rays;
+    Material material;
+    double sum;
+};
+
+// Runs the kernel over its batch of rays, first until it takes long enough
+// to be timed, then runs times keeping the fastest run
+template <class Kernel>
+double measure(Kernel &kernel, unsigned int batchSize, unsigned int runs)
+{
+    typedef std::chrono::steady_clock Clock;
+    const double minSeconds = 0.1;
+
+    unsigned int repeats = 1;
+    for (;;)
+    {
+        Clock::time_point start = Clock::now();
+        for (unsigned int i = 0; i < repeats; i++) kernel();
+        if (std::chrono::duration<double>(Clock::now() - start).count() >= minSeconds) break;
+        repeats *= 2;
+    }
+
+    double best = std::numeric_limits<double>::infinity();
+    for (unsigned int run = 0; run < runs; run++)
+    {
+        Clock::time_point start = Clock::now();
+        for (unsigned int i = 0; i < repeats; i++) kernel();
+        best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    return (double)batchSize * repeats / best / 1e6;
+}
+
+void runMicro(std::vector<Result> &results, unsigned int runs)
+{
+    const unsigned int batchSize = 1 << 14;
+    std::vector<Ray> rays = makeRays(batchSize, 1);
+
+    Sphere sphere(Point(0, 0, 0), 0.5);
+    Triangle triangle(Point(-0.5, -0.5, 0), Point(0.5, -0.5, 0), Point(0, 0.5, 0));
+    Plane plane(0, Vector(0, 1, 0));
+    Quad quad(Point(-0.5, -0.5, 0), Point(0.5, -0.5, 0), Point(0.5, 0.5, 0), Point(-0.5, 0.5, 0));
+
+    // the mesh fills the same unit cube, the cache is left alone
+    Mesh mesh("meshs/tweety.off", false);
+    mesh.position = Point(0, 0, 0);
+    mesh.size = 1;
+    mesh.scaleTranslate();
+    mesh.buildBlocks();
+
+    const char *names[] = { "sphere", "triangle", "plane", "quad", "mesh" };
+    Object *objects[] = { &sphere, &triangle, &plane, &quad, &mesh };
+    for (unsigned int i = 0; i < 5; i++)
+    {
+        IntersectKernel kernel(*objects[i], rays);
+        results.push_back(Result("micro", names[i], measure(kernel, batchSize, runs)));
+    }
+
+    PhongKernel phong(rays);
+    results.push_back(Result("micro", "phong", measure(phong, batchSize, runs)));
+}
+
+/************************** Macro benchmarks **********************************/
+
+// Renders every bench scene on one thread with its own settings, runs
+// times keeping the fastest render
+bool runMacro(std::vector<Result> &results, unsigned int runs)
+{
+    for (unsigned int i = 0; i < numBenchScenes; i++)
+    {
+        Raytracer raytracer;
+        if (!readBenchScene(raytracer, benchScenes[i])) return false;
+
+        Image img(raytracer.imageWidth(), raytracer.imageHeight());
+        double best = 0;
+        for (unsigned int run = 0; run < runs; run++)
+        {
+            Stats::reset();
+            {
+                Silence silence;
+                raytracer.render(img);
+            }
+            best = std::max(best, Stats::mraysPerSecond());
+        }
+        results.push_back(Result("macro", benchScenes[i], best));
+    }
+    return true;
+}
+
+/************************** Results **********************************/
+
+void writeJSON(std::ostream &out, const std::vector<Result> &results)
+{
+    out << "{" << std::endl;
+    for (unsigned int i = 0; i < results.size(); i++)
+    {
+        bool first = i == 0 || results[i - 1].group != results[i].group;
+        bool last = i + 1 == results.size() || results[i + 1].group != results[i].group;
+        if (first) out << "  \"" << results[i].group << "\": {" << std::endl;
+        out << "    \"" << results[i].name << "\": " << std::setprecision(4) << results[i].mrays << (last ? "" : ",") << std::endl;
+        if (last) out << "  }" << (i + 1 == results.size() ? "" : ",") << std::endl;
+    }
+    out << "}" << std::endl;
+}
+
+// JSON is read with the YAML parser, it is a subset of YAML
+bool readBaseline(const std::string &path, std::vector<Result> &results, std::vector<double> &baseline)
+{
+    std::ifstream fin(path.c_str());
+    if (!fin)
+    {
+        cerr << "Error: unable to open " << path << " for reading, record a baseline first with make bench-baseline." << endl;
+        return false;
+    }
+    try {
+        YAML::Parser parser(fin);
+        YAML::Node doc;
+        parser.GetNextDocument(doc);
+        for (unsigned int i = 0; i < results.size(); i++)
+        {
+            const YAML::Node *group = doc.FindValue(results[i].group);
+            const YAML::Node *value = group ? group->FindValue(results[i].name) : NULL;
+            double mrays = 0;
+            if (value) *value >> mrays;
+            baseline.push_back(mrays);
+        }
+    } catch(YAML::Exception& e) {
+        cerr << "Error in " << path << ": " << e.what() << endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *outputFile = NULL;
+    const char *baselineFile = NULL;
+    double tolerance = 30;
+    unsigned int runs = 5;
+    bool micro = true, macro = true;
+
+    bool badOption = false;
+    for (int arg = 1; arg < argc && !badOption; arg++) {
+        if (!strcmp(argv[arg], "-o") && arg + 1 < argc) {
+            outputFile = argv[++arg];
+        } else if (!strcmp(argv[arg], "-b") && arg + 1 < argc) {
+            baselineFile = argv[++arg];
+        } else if (!strcmp(argv[arg], "-t") && arg + 1 < argc) {
+            tolerance = atof(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-r") && arg + 1 < argc) {
+            runs = std::max(atoi(argv[++arg]), 1);
+        } else if (!strcmp(argv[arg], "--micro")) {
+            macro = false;
+        } else if (!strcmp(argv[arg], "--macro")) {
+            micro = false;
+        } else {
+            badOption = true;
+        }
+    }
+    if (badOption) {
+        cerr << "Usage: " << argv[0] << " [-o results.json] [-b baseline.json] [-t tolerance%] [-r runs] [--micro | --macro]" << endl;
+        return 1;
+    }
+
+    std::vector<Result> results;
+    if (micro) runMicro(results, runs);
+    if (macro && !runMacro(results, runs)) return 1;
+
+    std::vector<double> baseline;
+    if (baselineFile && !readBaseline(baselineFile, results, baseline)) return 1;
+
+    bool slower = false;
+    for (unsigned int i = 0; i < results.size(); i++)
+    {
+        const Result &r = results[i];
+        cout << std::left << std::setw(6) << r.group << " " << std::setw(42) << r.name << std::right
+             << std::fixed << std::setprecision(2) << std::setw(10) << r.mrays << " Mrays/s";
+        if (i < baseline.size() && baseline[i] > 0)
+        {
+            double change = 100 * (r.mrays / baseline[i] - 1);
+            cout << "   baseline " << std::setw(8) << baseline[i] << std::showpos << std::setw(8) << change << "%" << std::noshowpos;
+            if (change < -tolerance)
+            {
+                cout << "  SLOWER";
+                slower = true;
+            }
+        }
+        cout << std::defaultfloat << endl;
+    }
+
+    if (outputFile) {
+        std::ofstream out(outputFile);
+        writeJSON(out, results);
+        if (!out) {
+            cerr << "Error: unable to write " << outputFile << endl;
+            return 1;
+        }
+    }
+    return slower ? 1 : 0;
+}
@@ -0,0 +1,52 @@
+//
+//  Framework for a raytracer
+//  File: benchscenes.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "benchscenes.h"
+#include <fstream>
+#include <sstream>
+
+const char *benchScenes[] = {
+    "scene01", "scene02", "scene01-gooch", "scene01-lights-shadows",
+    "scene01-texture-ss-reflect-lights-shadows"
+};
+
+const unsigned int numBenchScenes = sizeof(benchScenes) / sizeof(benchScenes[0]);
+
+bool readBenchScene(Raytracer &raytracer, const std::string &name, const std::string &setting)
+{
+    std::string filename = name + ".yaml";
+    std::ifstream fin(filename.c_str());
+    if (!fin)
+    {
+        cerr << "Error: unable to read " << filename << ", run from the repository root." << endl;
+        return false;
+    }
+    std::ostringstream scene;
+    scene << fin.rdbuf() << "\n" << setting << "\n";
+
+    std::istringstream in(scene.str());
+    bool ok;
+    {
+        Silence silence;
+        ok = raytracer.readScene(in);
+    }
+    if (!ok)
+    {
+        cerr << "Error: unable to read " << filename << (setting.empty() ? "" : " with " + setting) << "." << endl;
+        return false;
+    }
+    raytracer.setThreads(1);
+    return true;
+}
@@ -0,0 +1,50 @@
+//
+//  Framework for a raytracer
+//  File: benchscenes.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef BENCHSCENES_H
+#define BENCHSCENES_H
+
+#include "../raytracer.h"
+#include <string>
+
+// The shipped scenes rendered by raybench and rayalloc, without .yaml
+extern const char *benchScenes[];
+extern const unsigned int numBenchScenes;
+
+// Drops the output of a render without allocating
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c) { return c; }
+};
+
+// Silences the output of the raytracer while it is in scope
+class Silence
+{
+public:
+    Silence() : out(cout.rdbuf(&silent)) { }
+    ~Silence() { cout.rdbuf(out); }
+
+private:
+    NullBuffer silent;
+    std::streambuf *out;
+};
+
+// Reads the bench scene name, with setting added at the end of its file,
+// and sets the raytracer to render it on one thread. The output of the
+// raytracer is silenced, false with an error when the scene can't be read.
+bool readBenchScene(Raytracer &raytracer, const std::string &name, const std::string &setting = "");
+
+#endif /* end of include guard: BENCHSCENES_H */
@@ -0,0 +1,192 @@
+//
+//  Framework for a raytracer
+//  File: bvh.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "bvh.h"
+#include <algorithm>
+
+/************************** BVH **********************************/
+
+namespace {
+
+// orders primitive indices by the position of their centroid along an axis
+class CentroidLess
+{
+public:
+    CentroidLess(const std::vector<Point> &centroids, int axis) : centroids(centroids), axis(axis) { }
+
+    bool operator()(unsigned int a, unsigned int b) const
+    {
+        return centroids[a].data[axis] < centroids[b].data[axis];
+    }
+
+    const std::vector<Point> &centroids;
+    int axis;
+};
+
+// tells whether a primitive falls on the lower side of a binned split
+class BelowSplit
+{
+public:
+    BelowSplit(const std::vector<Point> &centroids, const BBox &centroidBox, int axis, unsigned int split)
+        : centroids(centroids), centroidBox(centroidBox), axis(axis), split(split)
+    { }
+
+    bool operator()(unsigned int i) const
+    {
+        return binIndex(centroids[i], centroidBox, axis) < split;
+    }
+
+    static unsigned int binIndex(const Point &c, const BBox &centroidBox, int axis)
+    {
+        double extent = centroidBox.max.data[axis] - centroidBox.min.data[axis];
+        unsigned int bin = (unsigned int)(BVH::numBins * (c.data[axis] - centroidBox.min.data[axis]) / extent);
+        return bin < BVH::numBins ? bin : BVH::numBins - 1;
+    }
+
+    const std::vector<Point> &centroids;
+    const BBox &centroidBox;
+    int axis;
+    unsigned int split;
+};
+
+}
+
+void BVH::build(const std::vector<BBox> &boxes)
+{
+    nodes.clear();
+    indices.resize(boxes.size());
+    if (boxes.empty()) return;
+
+    std::vector<Point> centroids(boxes.size());
+    for (unsigned int i = 0; i < boxes.size(); i++)
+    {
+        indices[i] = i;
+        centroids[i] = boxes[i].centroid();
+    }
+
+    nodes.reserve(2 * boxes.size());
+    buildNode(boxes, centroids, 0, boxes.size(), 0);
+}
+
+unsigned int BVH::buildNode(const std::vector<BBox> &boxes, const std::vector<Point> &centroids,
+                            unsigned int begin, unsigned int end, unsigned int depth)
+{
+    unsigned int current = nodes.size();
+    nodes.push_back(BVHNode());
+
+    BBox box, centroidBox;
+    for (unsigned int i = begin; i < end; i++)
+    {
+        box.extend(boxes[indices[i]]);
+        centroidBox.extend(centroids[indices[i]]);
+    }
+    nodes[current].min = Vec3::roundDown(box.min);
+    nodes[current].max = Vec3::roundUp(box.max);
+
+    unsigned int count = end - begin;
+    if (count <= 1 || depth >= maxDepth)
+    {
+        return makeLeaf(current, begin, count);
+    }
+
+    // Binned surface area heuristic: evaluate the split planes between
+    // numBins equally sized bins on every axis of the centroid bounds and
+    // keep the cheapest one, with the cost of a primitive test set to 1.
+    int axis = -1;
+    unsigned int split = 0;
+    double bestCost = std::numeric_limits<double>::infinity();
+    for (int a = 0; a < 3; a++)
+    {
+        if (centroidBox.max.data[a] <= centroidBox.min.data[a]) continue;
+
+        BBox binBoxes[numBins];
+        unsigned int binCounts[numBins] = { 0 };
+        for (unsigned int i = begin; i < end; i++)
+        {
+            unsigned int bin = BelowSplit::binIndex(centroids[indices[i]], centroidBox, a);
+            binBoxes[bin].extend(boxes[indices[i]]);
+            binCounts[bin]++;
+        }
+
+        // sweep from the top to get the areas above every split plane
+        double aboveArea[numBins];
+        unsigned int aboveCount[numBins];
+        BBox above;
+        unsigned int n = 0;
+        for (unsigned int i = numBins - 1; i > 0; i--)
+        {
+            above.extend(binBoxes[i]);
+            n += binCounts[i];
+            aboveArea[i] = above.area();
+            aboveCount[i] = n;
+        }
+
+        BBox below;
+        n = 0;
+        for (unsigned int i = 1; i < numBins; i++)
+        {
+            below.extend(binBoxes[i - 1]);
+            n += binCounts[i - 1];
+            if (n == 0 || aboveCount[i] == 0) continue;
+            double cost = below.area() * n + aboveArea[i] * aboveCount[i];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                axis = a;
+                split = i;
+            }
+        }
+    }
+
+    if (axis < 0)
+    {
+        // all centroids coincide, no plane separates them
+        if (count <= maxLeafSize) return makeLeaf(current, begin, count);
+        axis = box.longestAxis();
+    }
+    else if (count <= maxLeafSize && 1 + bestCost / box.area() >= count)
+    {
+        return makeLeaf(current, begin, count);
+    }
+
+    unsigned int mid;
+    if (split > 0)
+    {
+        mid = std::partition(indices.begin() + begin, indices.begin() + end,
+                             BelowSplit(centroids, centroidBox, axis, split)) - indices.begin();
+    }
+    else
+    {
+        mid = begin + count / 2;
+        std::nth_element(indices.begin() + begin, indices.begin() + mid, indices.begin() + end,
+                         CentroidLess(centroids, axis));
+    }
+
+    buildNode(boxes, centroids, begin, mid, depth + 1);
+    unsigned int second = buildNode(boxes, centroids, mid, end, depth + 1);
+
+    nodes[current].offset = second;
+    nodes[current].count = 0;
+    nodes[current].axis = axis;
+    return current;
+}
+
+unsigned int BVH::makeLeaf(unsigned int current, unsigned int begin, unsigned int count)
+{
+    nodes[current].offset = begin;
+    nodes[current].count = count;
+    nodes[current].axis = 0;
+    return current;
+}
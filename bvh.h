@@ -0,0 +1,298 @@
+//
+//  Framework for a raytracer
+//  File: bvh.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include "bbox.h"
+#include "vec3.h"
+#include "raypacket.h"
+#include "stats.h"
+
+class BVHNode
+{
+public:
+    Vec3 min, max;          // bounds, rounded outwards to real precision
+    unsigned int offset;    // leaf: first entry in BVH::indices, inner node: index of the second child
+    unsigned int count;     // number of primitives in a leaf, 0 for inner nodes
+    unsigned int axis;      // split axis of an inner node, the first child is on the lower side
+
+    BBox box() const { return BBox(min.triple(), max.triple()); }
+
+    // Slab test, invD is the componentwise inverse of the ray direction.
+    // NaNs coming from 0 * inf are ignored by the comparisons.
+    bool intersect(const Vec3 &O, const Vec3 &invD, real tMax) const
+    {
+        real t0 = 0, t1 = tMax;
+        for (int i = 0; i < 3; i++)
+        {
+            real tA = (min[i] - O[i]) * invD[i];
+            real tB = (max[i] - O[i]) * invD[i];
+            if (tA > tB) std::swap(tA, tB);
+            if (tA > t0) t0 = tA;
+            if (tB < t1) t1 = tB;
+            if (t0 > t1) return false;
+        }
+        return true;
+    }
+};
+
+// Bounding volume hierarchy over a list of boxes. The hierarchy only knows
+// about primitive indices, the caller supplies the primitive tests.
+class BVH
+{
+public:
+    static const unsigned int maxLeafSize = 4;
+    static const unsigned int maxDepth = 60;
+    static const unsigned int numBins = 16;
+
+    void build(const std::vector<BBox> &boxes);
+    bool empty() const { return nodes.empty(); }
+
+    // Closest hit: isect(prim, tMax) tests a primitive and returns true when it
+    // found a hit closer than tMax, after having lowered tMax to that distance.
+    template <class Intersector>
+    bool intersect(const Ray &ray, double &tMax, Intersector &isect) const;
+
+    // Any hit: returns as soon as blocks(prim) returns true for a primitive in
+    // a leaf that the ray reaches before tMax.
+    template <class Predicate>
+    bool any(const Ray &ray, double tMax, Predicate &blocks) const;
+
+    // Same traversals calling the test once per leaf, isect(leaf, tMax) and
+    // blocks(leaf), for callers that store their primitives per leaf.
+    template <class LeafIntersector>
+    bool intersectLeaves(const Ray &ray, double &tMax, LeafIntersector &isect) const;
+    template <class LeafPredicate>
+    bool anyLeaf(const Ray &ray, double tMax, LeafPredicate &blocks) const;
+
+    // Closest hit for a ray packet: a node is visited when any ray of the
+    // packet reaches it, isect(prim) updates the lanes of the packet.
+    template <class PacketIntersector>
+    void intersect(RayPacket &packet, PacketIntersector &isect) const;
+
+    // Calls visit(i) for the primitives of the leaves containing p, the
+    // caller checks the primitives themselves
+    template <class Visitor>
+    void containing(const Vec3 &p, Visitor &visit) const;
+
+    std::vector<BVHNode> nodes;
+    std::vector<unsigned int> indices;
+
+private:
+    unsigned int buildNode(const std::vector<BBox> &boxes, const std::vector<Point> &centroids,
+                           unsigned int begin, unsigned int end, unsigned int depth);
+    unsigned int makeLeaf(unsigned int current, unsigned int begin, unsigned int count);
+};
+
+// Adapters running a per primitive test over the primitives of a leaf
+template <class Intersector>
+class PrimitiveLeaves
+{
+public:
+    PrimitiveLeaves(const std::vector<unsigned int> &indices, Intersector &isect) : indices(indices), isect(isect) { }
+
+    bool operator()(const BVHNode &leaf, double &tMax)
+    {
+        bool found = false;
+        for (unsigned int i = 0; i < leaf.count; i++)
+        {
+            if (isect(indices[leaf.offset + i], tMax)) found = true;
+        }
+        return found;
+    }
+
+    const std::vector<unsigned int> &indices;
+    Intersector &isect;
+};
+
+template <class Predicate>
+class BlockingLeaves
+{
+public:
+    BlockingLeaves(const std::vector<unsigned int> &indices, Predicate &blocks) : indices(indices), blocks(blocks) { }
+
+    bool operator()(const BVHNode &leaf)
+    {
+        for (unsigned int i = 0; i < leaf.count; i++)
+        {
+            if (blocks(indices[leaf.offset + i])) return true;
+        }
+        return false;
+    }
+
+    const std::vector<unsigned int> &indices;
+    Predicate &blocks;
+};
+
+template <class Intersector>
+bool BVH::intersect(const Ray &ray, double &tMax, Intersector &isect) const
+{
+    PrimitiveLeaves<Intersector> leaves(indices, isect);
+    return intersectLeaves(ray, tMax, leaves);
+}
+
+template <class Predicate>
+bool BVH::any(const Ray &ray, double tMax, Predicate &blocks) const
+{
+    BlockingLeaves<Predicate> leaves(indices, blocks);
+    return anyLeaf(ray, tMax, leaves);
+}
+
+template <class LeafIntersector>
+bool BVH::intersectLeaves(const Ray &ray, double &tMax, LeafIntersector &isect) const
+{
+    if (nodes.empty()) return false;
+
+    Vec3 O(ray.O);
+    Vec3 invD(Vector(1.0 / ray.D.x, 1.0 / ray.D.y, 1.0 / ray.D.z));
+    unsigned int stack[maxDepth + 4];
+    unsigned int top = 0;
+    stack[top++] = 0;
+    bool found = false;
+    unsigned int visited = 0;
+
+    while (top > 0)
+    {
+        unsigned int current = stack[--top];
+        const BVHNode &node = nodes[current];
+        visited++;
+        if (!node.intersect(O, invD, tMax)) continue;
+
+        if (node.count > 0)
+        {
+            if (isect(node, tMax)) found = true;
+        }
+        else if (ray.D.data[node.axis] < 0)
+        {
+            // visit the upper child first
+            stack[top++] = current + 1;
+            stack[top++] = node.offset;
+        }
+        else
+        {
+            stack[top++] = node.offset;
+            stack[top++] = current + 1;
+        }
+    }
+    Stats::count(Stats::BVHNodes, visited);
+    return found;
+}
+
+template <class LeafPredicate>
+bool BVH::anyLeaf(const Ray &ray, double tMax, LeafPredicate &blocks) const
+{
+    if (nodes.empty()) return false;
+
+    Vec3 O(ray.O);
+    Vec3 invD(Vector(1.0 / ray.D.x, 1.0 / ray.D.y, 1.0 / ray.D.z));
+    unsigned int stack[maxDepth + 4];
+    unsigned int top = 0;
+    stack[top++] = 0;
+    unsigned int visited = 0;
+    bool blocked = false;
+
+    while (top > 0 && !blocked)
+    {
+        unsigned int current = stack[--top];
+        const BVHNode &node = nodes[current];
+        visited++;
+        if (!node.intersect(O, invD, tMax)) continue;
+
+        if (node.count > 0)
+        {
+            blocked = blocks(node);
+        }
+        else
+        {
+            stack[top++] = node.offset;
+            stack[top++] = current + 1;
+        }
+    }
+    Stats::count(Stats::BVHNodes, visited);
+    return blocked;
+}
+
+template <class PacketIntersector>
+void BVH::intersect(RayPacket &packet, PacketIntersector &isect) const
+{
+    if (nodes.empty()) return;
+
+    unsigned int stack[maxDepth + 4];
+    unsigned int top = 0;
+    stack[top++] = 0;
+    unsigned int visited = 0;
+
+    while (top > 0)
+    {
+        unsigned int current = stack[--top];
+        const BVHNode &node = nodes[current];
+        visited++;
+        if (!packet.hitsBox(node.min, node.max)) continue;
+
+        if (node.count > 0)
+        {
+            for (unsigned int i = 0; i < node.count; i++)
+            {
+                isect(indices[node.offset + i]);
+            }
+        }
+        else if (packet.negativeDir(node.axis))
+        {
+            stack[top++] = current + 1;
+            stack[top++] = node.offset;
+        }
+        else
+        {
+            stack[top++] = node.offset;
+            stack[top++] = current + 1;
+        }
+    }
+    Stats::count(Stats::BVHNodes, visited);
+}
+
+template <class Visitor>
+void BVH::containing(const Vec3 &p, Visitor &visit) const
+{
+    if (nodes.empty()) return;
+
+    unsigned int stack[maxDepth + 4];
+    unsigned int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0)
+    {
+        unsigned int current = stack[--top];
+        const BVHNode &node = nodes[current];
+        if (p.x < node.min.x || p.y < node.min.y || p.z < node.min.z ||
+            p.x > node.max.x || p.y > node.max.y || p.z > node.max.z) continue;
+
+        if (node.count > 0)
+        {
+            for (unsigned int i = 0; i < node.count; i++)
+            {
+                visit(indices[node.offset + i]);
+            }
+        }
+        else
+        {
+            stack[top++] = node.offset;
+            stack[top++] = current + 1;
+        }
+    }
+}
+
+#endif /* end of include guard: BVH_H */
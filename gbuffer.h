@@ -0,0 +1,53 @@
+//
+//  Framework for a raytracer
+//  File: gbuffer.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <vector>
+#include "triple.h"
+
+class Object;
+
+// Geometry buffer of the deferred mode: the closest hits of the camera rays
+// of a tile, kept in single precision and shaded afterwards sorted by
+// material. A render thread keeps one and reuses it for every tile, see
+// RenderBuffers.
+class GBuffer
+{
+public:
+    class Sample
+    {
+    public:
+        float t;                // distance along the camera ray
+        float nx, ny, nz;       // normal at the hit
+        float u, v;             // texture coordinates, for textured materials only
+        float lod;              // mip level of the texture lookup
+        const Object *obj;
+        unsigned int sample;    // AA sample of the tile
+    };
+
+    // makes room for a tile of the given number of camera rays
+    void reserve(unsigned int numRays)
+    {
+        hits.reserve(numRays);
+        colors.reserve(numRays);
+    }
+
+    std::vector<Sample> hits;
+    std::vector<Color> colors;  // color of every AA sample of the tile
+};
+
+#endif /* end of include guard: GBUFFER_H */
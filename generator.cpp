@@ -0,0 +1,178 @@
+//
+//  Framework for a raytracer
+//  File: generator.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "generator.h"
+#include "sphere.h"
+#include "triangle.h"
+#include "quad.h"
+#include "mesh.h"
+
+/************************** Random **********************************/
+
+double Random::gaussian()
+{
+    double u = 1 - (*this)();   // in (0, 1]
+    double v = (*this)();
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+Vector Random::direction()
+{
+    double z = 2 * (*this)() - 1;
+    double phi = 2 * M_PI * (*this)();
+    double r = sqrt(1 - z * z);
+    return Vector(r * cos(phi), r * sin(phi), z);
+}
+
+/************************** Distribution **********************************/
+
+Distribution::Distribution(const Point &min, const Point &max, unsigned int clusters, double spread, Random &random)
+    : min(min), max(max), spread(spread)
+{
+    for (unsigned int i = 0; i < clusters; i++)
+    {
+        centers.push_back(Distribution(min, max)(random));
+    }
+}
+
+Point Distribution::operator()(Random &random) const
+{
+    if (centers.empty())
+    {
+        return Point(random.range(min.x, max.x), random.range(min.y, max.y), random.range(min.z, max.z));
+    }
+
+    const Point &center = centers[(unsigned int)(random() * centers.size())];
+    Vector sigma = (max - min) * spread;
+    return center + Vector(random.gaussian() * sigma.x, random.gaussian() * sigma.y, random.gaussian() * sigma.z);
+}
+
+/************************** Generator **********************************/
+
+Object* Generator::sphere(Arena &arena, const Point &center, double size)
+{
+    return arena.create<Sphere>(center, size);
+}
+
+Object* Generator::triangle(Arena &arena, const Point &center, double size, Random &random)
+{
+    // equilateral, in the plane orthogonal to a random normal
+    Vector n = random.direction();
+    Vector u = n.cross(fabs(n.x) < 0.9 ? Vector(1, 0, 0) : Vector(0, 1, 0)).normalized();
+    Vector v = n.cross(u);
+    double r = size / sqrt(3.0);
+
+    return arena.create<Triangle>(center + r * u,
+                                  center + r * (-0.5 * u + 0.5 * sqrt(3.0) * v),
+                                  center + r * (-0.5 * u - 0.5 * sqrt(3.0) * v));
+}
+
+Object* Generator::quad(Arena &arena, const Point &center, double size, Random &random)
+{
+    Vector n = random.direction();
+    Vector u = n.cross(fabs(n.x) < 0.9 ? Vector(1, 0, 0) : Vector(0, 1, 0)).normalized() * (size / 2);
+    Vector v = n.cross(u);
+
+    return arena.create<Quad>(center - u - v, center + u - v, center + u + v, center - u + v);
+}
+
+// The triangles are ordered so that e01 x e02 points outwards, which is the
+// side Triangle and the mesh kernels see as the front.
+Mesh* Generator::tessellatedSphere(Arena &arena, unsigned int resolution)
+{
+    unsigned int rings = std::max(2u, resolution);
+    unsigned int segments = 2 * rings;
+    Mesh *mesh = arena.create<Mesh>();
+
+    // north pole, the rings from north to south, south pole
+    mesh->m_positions.push_back(Point(0, 1, 0));
+    for (unsigned int i = 1; i < rings; i++)
+    {
+        double theta = M_PI * i / rings;
+        for (unsigned int j = 0; j < segments; j++)
+        {
+            double phi = 2 * M_PI * j / segments;
+            mesh->m_positions.push_back(Point(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi)));
+        }
+    }
+    mesh->m_positions.push_back(Point(0, -1, 0));
+
+    unsigned int south = mesh->m_positions.size() - 1;
+    for (unsigned int j = 0; j < segments; j++)
+    {
+        unsigned int next = (j + 1) % segments;
+        mesh->m_triangles.push_back(MeshTriangle(0, 1 + next, 1 + j));
+        for (unsigned int i = 1; i + 1 < rings; i++)
+        {
+            unsigned int a = 1 + (i - 1) * segments + j;
+            unsigned int b = 1 + (i - 1) * segments + next;
+            mesh->m_triangles.push_back(MeshTriangle(a, b, a + segments));
+            mesh->m_triangles.push_back(MeshTriangle(b, b + segments, a + segments));
+        }
+        unsigned int last = 1 + (rings - 2) * segments;
+        mesh->m_triangles.push_back(MeshTriangle(last + j, last + next, south));
+    }
+
+    mesh->recomputeNormals();
+    mesh->buildBVH();
+    return mesh;
+}
+
+Mesh* Generator::terrain(Arena &arena, unsigned int resolution, Random &random)
+{
+    const unsigned int waves = 4;
+    unsigned int n = std::max(1u, resolution);
+    Mesh *mesh = arena.create<Mesh>();
+
+    // every wave has half the amplitude and twice the frequency of the previous one
+    Vector direction[waves];
+    double phase[waves];
+    for (unsigned int k = 0; k < waves; k++)
+    {
+        direction[k] = random.direction();
+        direction[k].y = 0;
+        direction[k] = direction[k].normalized() * (M_PI * (1 << k));
+        phase[k] = 2 * M_PI * random();
+    }
+
+    for (unsigned int i = 0; i <= n; i++)
+    {
+        for (unsigned int j = 0; j <= n; j++)
+        {
+            Point p(2.0 * j / n - 1, 0, 2.0 * i / n - 1);
+            for (unsigned int k = 0; k < waves; k++)
+            {
+                p.y += 0.1 / (1 << k) * sin(direction[k].dot(p) + phase[k]);
+            }
+            mesh->m_positions.push_back(p);
+        }
+    }
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        for (unsigned int j = 0; j < n; j++)
+        {
+            unsigned int a = i * (n + 1) + j;
+            unsigned int b = a + 1;
+            unsigned int c = a + n + 1;
+            mesh->m_triangles.push_back(MeshTriangle(a, c, b));
+            mesh->m_triangles.push_back(MeshTriangle(b, c, c + 1));
+        }
+    }
+
+    mesh->recomputeNormals();
+    mesh->buildBVH();
+    return mesh;
+}
@@ -0,0 +1,87 @@
+//
+//  Framework for a raytracer
+//  File: generator.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <random>
+#include <vector>
+#include "triple.h"
+#include "arena.h"
+
+class Object;
+class Mesh;
+
+// Random numbers in [0, 1) that are the same on every platform, unlike the
+// standard distributions, so a seed always gives the same scene
+class Random
+{
+public:
+    Random(unsigned int seed) : engine(seed) { }
+
+    double operator()()
+    {
+        return (engine() - engine.min()) / (double)(engine.max() - engine.min() + 1);
+    }
+
+    double range(double min, double max) { return min + (max - min) * (*this)(); }
+
+    // standard normal distribution (Box-Muller)
+    double gaussian();
+
+    // uniform on the unit sphere
+    Vector direction();
+
+private:
+    std::minstd_rand engine;
+};
+
+// Positions of generated objects and lights in the box [min, max]: either
+// uniform, or normally distributed around a number of uniform cluster
+// centers, spread being the standard deviation relative to the box size.
+class Distribution
+{
+public:
+    Distribution(const Point &min, const Point &max) : min(min), max(max), spread(0) { }
+    Distribution(const Point &min, const Point &max, unsigned int clusters, double spread, Random &random);
+
+    Point operator()(Random &random) const;
+
+private:
+    Point min, max;
+    std::vector<Point> centers;
+    double spread;
+};
+
+// Builds the objects of procedural scenes, used to see how loading and
+// rendering scale with the number of primitives
+class Generator
+{
+public:
+    // size is the radius of a sphere and the edge length of the others,
+    // triangles and quads get a random orientation
+    static Object* sphere(Arena &arena, const Point &center, double size);
+    static Object* triangle(Arena &arena, const Point &center, double size, Random &random);
+    static Object* quad(Arena &arena, const Point &center, double size, Random &random);
+
+    // unit sphere with resolution rings of 2 * resolution quads
+    static Mesh* tessellatedSphere(Arena &arena, unsigned int resolution);
+
+    // height field over [-1, 1] x [-1, 1] made of a few random waves, with
+    // 2 * resolution^2 triangles
+    static Mesh* terrain(Arena &arena, unsigned int resolution, Random &random);
+};
+
+#endif /* end of include guard: GENERATOR_H */
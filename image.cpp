@@ -24,11 +24,51 @@ bool Image::set_extent(int width, int height)
     _width = width;
     _height = height;
     if (_pixel) delete[] _pixel;
+    delete _mip;
+    _mip = 0;
     _pixel = size() > 0 ? new Color[size()] : 0;
     return _pixel != 0;
 }
 
 
+/*
+* Every mip level is half the size of the one above, each pixel the average
+* of 2x2 pixels of it. Odd rows and columns are folded into the last pixel.
+*/
+void Image::buildMipmaps()
+{
+    if (_mip || (_width <= 1 && _height <= 1)) return;
+
+    int w = _width > 1 ? _width / 2 : 1;
+    int h = _height > 1 ? _height / 2 : 1;
+    _mip = new Image(w, h);
+    for (int y = 0; y < h; y++) {
+        int y0 = 2 * y, y1 = (y == h - 1) ? _height - 1 : 2 * y + 1;
+        for (int x = 0; x < w; x++) {
+            int x0 = 2 * x, x1 = (x == w - 1) ? _width - 1 : 2 * x + 1;
+            Color sum(0.0, 0.0, 0.0);
+            for (int j = y0; j <= y1; j++) {
+                for (int i = x0; i <= x1; i++) sum += (*this)(i, j);
+            }
+            (*_mip)(x, y) = sum / ((x1 - x0 + 1) * (y1 - y0 + 1));
+        }
+    }
+    _mip->buildMipmaps();
+}
+
+Color Image::trilinearAt(float x, float y, float level) const
+{
+    const Image *img = this;
+    while (level >= 1 && img->_mip) {
+        img = img->_mip;
+        level -= 1;
+    }
+    Color color = img->bilinearAt(x, y);
+    if (level <= 0 || !img->_mip) return color;
+    return color * (1 - level) + img->_mip->bilinearAt(x, y) * level;
+}
+
+
 void Image::write_png(const char* filename) const
 {
     std::vector<unsigned char> image;
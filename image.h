@@ -25,16 +25,17 @@ protected:
     Color* _pixel;
     int _width;
     int _height;
+    Image* _mip;    // next mip level, half the size, see buildMipmaps
 
 public:
     Image(int width=0, int height=0)
-        : _pixel(0), _width(0), _height(0)
+        : _pixel(0), _width(0), _height(0), _mip(0)
     {
         set_extent(width, height);    //creates array
     }
 
     Image(const char *imageFilename)
-        : _pixel(0), _width(0), _height(0)
+        : _pixel(0), _width(0), _height(0), _mip(0)
     {
         read_png(imageFilename);
     }
@@ -44,6 +45,7 @@ public:
     ~Image()
     {
         if (_pixel) delete[] _pixel;
+        delete _mip;
     }
 
     // Normal accessors
@@ -56,9 +58,22 @@ public:
     inline const Color& operator()(int x, int y) const;
     inline Color& operator()(int x, int y);
 
-    // Normalized accessors, interval is (0...1, 0...1)
+    // Normalized accessors, interval is (0...1, 0...1). Pixel x covers
+    // x / width to (x + 1) / width, its center is at (x + 0.5) / width, the
+    // same for y. x wraps around and y is clamped.
     inline const Color& colorAt(float x, float y) const;
 
+    // Filtered normalized accessors. bilinearAt blends the four pixels
+    // around the point, trilinearAt blends bilinearAt of the two mip levels
+    // around level (0 is the image itself, every level halves it). The last
+    // column blends into the first, so a texture around a sphere has no
+    // seam.
+    inline Color bilinearAt(float x, float y) const;
+    Color trilinearAt(float x, float y, float level) const;
+
+    // Builds the mip levels used by trilinearAt, down to 1x1
+    void buildMipmaps();
+
     // Normalized accessors for bumpmapping. Uses green component.
     inline void derivativeAt(float x, float y, float *dx, float *dy) const;
 
@@ -67,6 +82,10 @@ public:
     inline int height() const   { return _height; }
     inline int size() const     { return _width * _height; }
 
+    // Create a picture, dropping the old one and its mip levels.
+    // Return false if failed.
+    bool set_extent(int width, int height);
+
     // File stuff
     void write_png(const char* filename) const;
     void read_png(const char* filename);
@@ -79,11 +98,15 @@ protected:
     inline int windex(int x, int y) const           //wrapped integer index
     { return index(x % _width, y % _height); }
 
-    inline int findex(float x, float y) const       //float index
-    { return index(int(x * (_width-1)), int(y * (_height-1))); }
+    inline int findex(float x, float y) const       //float index, x wrapped, y clamped
+    {
+        int ix = int((x - floorf(x)) * _width), iy = int(y * _height);
+        return index(ix < _width ? ix : _width - 1, iy < 0 ? 0 : (iy < _height ? iy : _height - 1));
+    }
 
-    // Create a picture. Return false if failed.
-    bool set_extent(int width, int height);
+private:
+    Image(const Image &);
+    Image& operator=(const Image &);
 
 };
 
@@ -115,6 +138,22 @@ inline const Color& Image::colorAt(float x, float y) const
     return _pixel[findex(x, y)];
 }
 
+inline Color Image::bilinearAt(float x, float y) const
+{
+    float fx = (x - floorf(x)) * _width - 0.5f;
+    float fy = y * _height - 0.5f;
+    if (fx < 0) fx += _width;
+    fy = fy < 0 ? 0 : (fy > _height - 1 ? _height - 1 : fy);
+    int x0 = (int)fx < _width ? (int)fx : _width - 1, y0 = (int)fy;
+    int x1 = x0 + 1 < _width ? x0 + 1 : 0;
+    int y1 = y0 + 1 < _height ? y0 + 1 : y0;
+    float ax = fx - x0, ay = fy - y0;
+
+    Color top = _pixel[index(x0, y0)] * (1 - ax) + _pixel[index(x1, y0)] * ax;
+    Color bottom = _pixel[index(x0, y1)] * (1 - ax) + _pixel[index(x1, y1)] * ax;
+    return top * (1 - ay) + bottom * ay;
+}
+
 inline void Image::derivativeAt(float x, float y, float *dx, float *dy) const
 {
     int ix = (int)(x * (_width - 1));
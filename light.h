@@ -25,11 +25,22 @@
 class Light
 {
 public:
-    Light(Point pos,Color c) : position(pos), color(c)
+    Light(Point pos,Color c,double r = 0) : position(pos), color(c), radius(r)
     { }
 
+    // Smooth falloff reaching 0 at the radius, lights without a radius
+    // reach everywhere
+    double attenuation(double distance) const
+    {
+        if (radius <= 0) return 1;
+        double x = distance / radius;
+        double window = 1 - x * x * x * x;
+        return window > 0 ? window * window : 0;
+    }
+
     Point position;
     Color color;
+    double radius;  // 0 for no falloff
 };
 
 class Ray
@@ -38,6 +49,8 @@ public:
     Point O;
     Vector D;
 
+    Ray() { }
+
     Ray(const Point &from, const Vector &dir)
         : O(from), D(dir)
     { }
@@ -47,18 +60,22 @@ public:
 
 };
 
+// Result of an intersection test: the distance and what the primitive needs
+// to find the surface again. The normal is only computed, by
+// Object::normal, for the closest hit of a ray.
 class Hit
 {
 public:
     double t;
-    Vector N;
+    float u, v;         // barycentric coordinates, for triangles
+    unsigned int prim;  // part of the object that was hit, e.g. a triangle of a mesh
     bool no_hit;
     
-    Hit(const double t, const Vector &normal, bool nohit = false)
-        : t(t), N(normal), no_hit(nohit)
+    Hit(const double t, unsigned int prim = 0, float u = 0.0f, float v = 0.0f, bool nohit = false)
+        : t(t), u(u), v(v), prim(prim), no_hit(nohit)
     { }
 
-    static const Hit NO_HIT() { static Hit no_hit(std::numeric_limits<double>::quiet_NaN(),Vector(std::numeric_limits<double>::quiet_NaN(),std::numeric_limits<double>::quiet_NaN(),std::numeric_limits<double>::quiet_NaN()), true); return no_hit; }
+    static const Hit NO_HIT() { static Hit no_hit(std::numeric_limits<double>::quiet_NaN(), 0, 0.0f, 0.0f, true); return no_hit; }
 
 };
 
@@ -15,26 +15,53 @@
 //
 
 #include "raytracer.h"
+#include "stats.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 
 int main(int argc, char *argv[])
 {
     cout << "Introduction to Computer Graphics - Raytracer" << endl << endl;
-    if (argc < 2 || argc > 3) {
-        cerr << "Usage: " << argv[0] << " in-file [out-file.png]" << endl;
+
+    // options come before the file names
+    int threads = -1;
+    const char *statsFile = NULL;
+    bool badOption = false;
+    int arg = 1;
+    while (arg < argc && argv[arg][0] == '-' && !badOption) {
+        if ((!strcmp(argv[arg], "-t") || !strcmp(argv[arg], "--threads")) && arg + 1 < argc) {
+            threads = atoi(argv[arg + 1]);
+            arg += 2;
+        } else if ((!strcmp(argv[arg], "-s") || !strcmp(argv[arg], "--stats")) && arg + 1 < argc) {
+            statsFile = argv[arg + 1];
+            arg += 2;
+        } else {
+            badOption = true;
+        }
+    }
+
+    if (badOption || argc - arg < 1 || argc - arg > 2 || threads < -1) {
+        cerr << "Usage: " << argv[0] << " [-t threads] [-s stats.json] in-file [out-file.png]" << endl;
         return 1;
     }
 
     Raytracer raytracer;
 
-    if (!raytracer.readScene(argv[1])) {
-        cerr << "Error: reading scene from " << argv[1] << " failed - no output generated."<< endl;
+    if (!raytracer.readScene(argv[arg])) {
+        cerr << "Error: reading scene from " << argv[arg] << " failed - no output generated."<< endl;
         return 1;
     }
+    // the command line overrides the Threads setting of the scene
+    if (threads >= 0) {
+        raytracer.setThreads(threads);
+    }
+
     std::string ofname;
-    if (argc>=3) {
-        ofname = argv[2];
+    if (argc - arg >= 2) {
+        ofname = argv[arg + 1];
     } else {
-        ofname = argv[1];
+        ofname = argv[arg];
         if (ofname.size()>=5 && ofname.substr(ofname.size()-5)==".yaml") {
             ofname = ofname.substr(0,ofname.size()-5);
         }
@@ -42,5 +69,15 @@ int main(int argc, char *argv[])
     }
     raytracer.renderToFile(ofname);
 
+    Stats::print(cout);
+    if (statsFile) {
+        std::ofstream out(statsFile);
+        Stats::writeJSON(out);
+        if (!out) {
+            cerr << "Error: unable to write statistics to " << statsFile << endl;
+            return 1;
+        }
+    }
+
     return 0;
 }
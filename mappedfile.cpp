@@ -0,0 +1,92 @@
+//
+//  Framework for a raytracer
+//  File: mappedfile.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "mappedfile.h"
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+/************************** MappedFile **********************************/
+
+bool MappedFile::open(const std::string &path)
+{
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    m_size = st.st_size;
+
+    if (m_size > 0)
+    {
+        void *p = mmap(0, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            m_data = (const char *)p;
+            m_mapped = true;
+        }
+    }
+    ::close(fd);
+    if (m_mapped || m_size == 0) return true;
+#endif
+
+    // no mmap, read the whole file instead
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in) return false;
+    in.seekg(0, std::ios::end);
+    m_size = in.tellg();
+    in.seekg(0, std::ios::beg);
+    m_buffer.resize(m_size);
+    if (m_size > 0 && !in.read(&m_buffer[0], m_size))
+    {
+        close();
+        return false;
+    }
+    m_data = m_size > 0 ? &m_buffer[0] : 0;
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifndef _WIN32
+    if (m_mapped) munmap((void *)m_data, m_size);
+#endif
+    m_mapped = false;
+    m_data = 0;
+    m_size = 0;
+    m_buffer.clear();
+}
+
+bool MappedFile::stat(const std::string &path, unsigned long long &size, long long &mtime)
+{
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) return false;
+    size = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+}
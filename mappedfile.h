@@ -0,0 +1,49 @@
+//
+//  Framework for a raytracer
+//  File: mappedfile.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <vector>
+
+// Read only view of a whole file. The file is memory mapped where mmap is
+// available, and read into a buffer otherwise.
+class MappedFile
+{
+public:
+    MappedFile() : m_data(0), m_size(0), m_mapped(false) { }
+    ~MappedFile() { close(); }
+
+    bool open(const std::string &path);
+    void close();
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+    // size and modification time of a file, false if it doesn't exist
+    static bool stat(const std::string &path, unsigned long long &size, long long &mtime);
+
+private:
+    MappedFile(const MappedFile &);
+    MappedFile& operator=(const MappedFile &);
+
+    const char *m_data;
+    size_t m_size;
+    bool m_mapped;
+    std::vector<char> m_buffer;
+};
+
+#endif /* end of include guard: MAPPEDFILE_H */
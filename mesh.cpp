@@ -15,59 +15,134 @@
 
 
 #include "mesh.h"
+#include "meshcache.h"
+#include "meshloader.h"
+#include <stdexcept>
 
 /************************** Mesh **********************************/
 
-Mesh::Mesh(std::string meshPath)
+Mesh::Mesh() : Object(Stats::MeshTests), size(1)
 {
-    ifstream in (meshPath.c_str ());
-    if (!in) 
+}
+
+Mesh::Mesh(std::string meshPath, bool useCache) : Object(Stats::MeshTests)
+{
+    if (useCache && MeshCache::read(*this, meshPath))
     {
-        exit (1);
+        std::cout << "Read: " << MeshCache::cachePath(meshPath) << " Points read: " << m_positions.size() << " Triangles read: " << m_triangles.size() << std::endl;
+        return;
     }
-    string offString;
-    unsigned int sizeV, sizeT, tmp;
-    in >> offString >> sizeV >> sizeT >> tmp;
-    m_positions.resize (sizeV);
-    m_triangles.resize (sizeT);
-    for (unsigned int i = 0; i < sizeV; i++)
+
+    std::string error;
+    if (!MeshLoader::load(meshPath, m_positions, m_triangles, error))
     {
-        in >> m_positions[i].x;
-        in >> m_positions[i].y;
-        in >> m_positions[i].z;
-    }
-    int s;
-    for (unsigned int i = 0; i < sizeT; i++) {
-        in >> s;
-        for (unsigned int j = 0; j < 3; j++)
-        {
-            in >> m_triangles[i][j];
-        }
+        throw std::runtime_error(error);
     }
-    in.close ();
 
-    std::cout << "Read: " << meshPath << " Points read: " << sizeV << " Triangles read: " << sizeT << std::endl;
+    std::cout << "Read: " << meshPath << " Points read: " << m_positions.size() << " Triangles read: " << m_triangles.size() << std::endl;
 
     recomputeNormals ();
+    buildBVH ();
+
+    if (useCache && !MeshCache::write(*this, meshPath))
+    {
+        std::cerr << "Warning: unable to write the mesh cache " << MeshCache::cachePath(meshPath) << std::endl;
+    }
 }
 
+// BVH leaf test keeping the closest triangle of a mesh
+class ClosestTriangle
+{
+public:
+    ClosestTriangle(const Mesh &mesh, const Ray &ray) : mesh(mesh), O(ray.O), D(ray.D), block(0), lane(0) { }
+
+    bool operator()(const BVHNode &leaf, double &tMax)
+    {
+        bool found = false;
+        real t[TriangleBlock::size];
+        Stats::count(Stats::MeshTriangleTests, leaf.count * TriangleBlock::size);
+        for (unsigned int i = leaf.offset; i < leaf.offset + leaf.count; i++)
+        {
+            int hits = mesh.m_blocks[i].intersect(O, D, tMax, t);
+            for (unsigned int j = 0; hits; j++, hits >>= 1)
+            {
+                if ((hits & 1) && t[j] < tMax)
+                {
+                    tMax = t[j];
+                    block = i;
+                    lane = j;
+                    found = true;
+                }
+            }
+        }
+        return found;
+    }
+
+    const Mesh &mesh;
+    Vec3 O, D;
+    unsigned int block, lane;
+};
+
 Hit Mesh::intersect(const Ray &ray)
 {
-    for (unsigned int i = 0 ; i < m_triangles.size(); ++i)
+    double tMax = std::numeric_limits<double>::infinity();
+    ClosestTriangle closest(*this, ray);
+
+    if(m_bvh.intersectLeaves(ray, tMax, closest))
     {
+        return Hit(tMax, closest.block * TriangleBlock::size + closest.lane);
+    }
+    return Hit::NO_HIT();
+}
 
-        Triangle t(m_positions[m_triangles[i][0]],
-                    m_positions[m_triangles[i][1]],
-                    m_positions[m_triangles[i][2]]);
+Vector Mesh::normal(const Ray &ray, const Hit &hit) const
+{
+    const TriangleBlock &block = m_blocks[hit.prim / TriangleBlock::size];
+    unsigned int lane = hit.prim % TriangleBlock::size;
+    return Vector(block.nx[lane], block.ny[lane], block.nz[lane]);
+}
 
-        const Hit h = t.intersect(ray);
+// BVH leaf test for shadow rays, stops at the first block with a hit in range
+class BlockingTriangle
+{
+public:
+    BlockingTriangle(const Mesh &mesh, const Ray &ray, double tMax) : mesh(mesh), O(ray.O), D(ray.D), tMax(tMax) { }
 
-        if(!h.no_hit)
+    bool operator()(const BVHNode &leaf)
+    {
+        real t[TriangleBlock::size];
+        for (unsigned int i = leaf.offset; i < leaf.offset + leaf.count; i++)
         {
-            return Hit(h.t, m_normals[i]);
+            Stats::count(Stats::MeshTriangleTests, TriangleBlock::size);
+            if (mesh.m_blocks[i].intersect(O, D, tMax, t)) return true;
         }
+        return false;
     }
-    return Hit::NO_HIT();
+
+    const Mesh &mesh;
+    Vec3 O, D;
+    real tMax;
+};
+
+bool Mesh::occluded(const Ray &ray, double tMax)
+{
+    BlockingTriangle blocking(*this, ray, tMax);
+    return m_bvh.anyLeaf(ray, tMax, blocking);
+}
+
+BBox Mesh::bounds() const
+{
+    if (!m_bvh.empty())
+    {
+        return m_bvh.nodes[0].box();
+    }
+
+    BBox box;
+    for (unsigned int i = 0; i < m_positions.size(); i++)
+    {
+        box.extend(m_positions[i]);
+    }
+    return box;
 }
 
 // -------------- Helpers -------------------
@@ -103,6 +178,8 @@ void Mesh::recomputeNormals () {
 
 }
 
+// Also moves the BVH along: scaling and translating every box gives the
+// hierarchy that would be built on the new positions.
 void Mesh::scaleTranslate()
 {
     for (unsigned int i = 0; i < m_positions.size(); i++)
@@ -110,4 +187,53 @@ void Mesh::scaleTranslate()
         m_positions[i] *= size;
         m_positions[i] += position;
     }
+
+    for (unsigned int i = 0; i < m_bvh.nodes.size(); i++)
+    {
+        BVHNode &node = m_bvh.nodes[i];
+        BBox box(node.min.triple() * size + position, node.max.triple() * size + position);
+        node.min = Vec3::roundDown(box.min);
+        node.max = Vec3::roundUp(box.max);
+    }
+}
+
+void Mesh::buildBVH()
+{
+    PhaseTimer timer(Stats::BuildPhase);
+    std::vector<BBox> boxes(m_triangles.size());
+    for (unsigned int i = 0; i < m_triangles.size(); i++)
+    {
+        boxes[i] = BBox(m_positions[m_triangles[i][0]], m_positions[m_triangles[i][1]]);
+        boxes[i].extend(m_positions[m_triangles[i][2]]);
+    }
+    m_bvh.build(boxes);
+}
+
+// Packs the triangles of every leaf into blocks and makes the leaf point at
+// its blocks instead of m_bvh.indices. Done once the mesh is in place.
+void Mesh::buildBlocks()
+{
+    PhaseTimer timer(Stats::BuildPhase);
+    m_blocks.clear();
+    for (unsigned int n = 0; n < m_bvh.nodes.size(); n++)
+    {
+        BVHNode &leaf = m_bvh.nodes[n];
+        if (leaf.count == 0) continue;
+
+        unsigned int first = m_blocks.size();
+        for (unsigned int i = 0; i < leaf.count; i++)
+        {
+            if (i % TriangleBlock::size == 0) m_blocks.push_back(TriangleBlock());
+
+            unsigned int t = m_bvh.indices[leaf.offset + i];
+            m_blocks.back().set(i % TriangleBlock::size,
+                                Vec3(m_positions[m_triangles[t][0]]),
+                                Vec3(m_positions[m_triangles[t][1]]),
+                                Vec3(m_positions[m_triangles[t][2]]),
+                                Vec3(m_normals[t]), t);
+        }
+        leaf.offset = first;
+        leaf.count = m_blocks.size() - first;
+    }
+    m_bvh.indices.clear();
 }
\ No newline at end of file
@@ -19,6 +19,8 @@
 #include "object.h"
 #include "triangle.h"
 #include "meshtriangle.h"
+#include "bvh.h"
+#include "triangleblock.h"
 #include <iostream>
 #include <fstream>
 #include <math.h>
@@ -27,15 +29,25 @@
 class Mesh : public Object
 {
 public:
-    Mesh(std::string meshPath);
+    // empty mesh, to be filled by the caller
+    Mesh();
+    // reads an OFF, OBJ or PLY model, throws std::runtime_error on failure
+    Mesh(std::string meshPath, bool useCache = true);
 
     virtual Hit intersect(const Ray &ray);
+    virtual Vector normal(const Ray &ray, const Hit &hit) const;
+    virtual bool occluded(const Ray &ray, double tMax);
+    virtual BBox bounds() const;
     void scaleTranslate();
     void recomputeNormals ();
+    void buildBVH();
+    void buildBlocks();
 
     std::vector<Point> m_positions;
     std::vector<Vector> m_normals;
     std::vector<MeshTriangle> m_triangles;
+    BVH m_bvh;                              // its leaves index m_blocks after buildBlocks
+    std::vector<TriangleBlock> m_blocks;    // triangles laid out for intersection
     Point position;
     float size;
 };
@@ -0,0 +1,187 @@
+//
+//  Framework for a raytracer
+//  File: meshcache.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "meshcache.h"
+#include "mesh.h"
+#include "mappedfile.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+/************************** MeshCache **********************************/
+
+namespace {
+
+const char magic[8] = { 'R', 'T', 'M', 'E', 'S', 'H', 0, 0 };
+const unsigned int version = 1;
+const unsigned int byteOrder = 0x01020304;
+
+// The header is followed by the arrays, in this order:
+// positions, triangles, normals, BVH nodes, BVH indices.
+class MeshCacheHeader
+{
+public:
+    char magic[8];
+    unsigned int version;
+    unsigned int byteOrder;
+    unsigned int realSize;
+    unsigned int nodeSize;
+    unsigned long long sourceSize;
+    long long sourceMtime;
+    unsigned int numPositions;
+    unsigned int numTriangles;
+    unsigned int numNodes;
+    unsigned int numIndices;
+};
+
+template <class T>
+bool readArray(std::vector<T> &array, unsigned int count, const char *&p, const char *end)
+{
+    if ((size_t)(end - p) < count * sizeof(T)) return false;
+    array.resize(count);
+    if (count > 0) memcpy((void *)&array[0], p, count * sizeof(T));
+    p += count * sizeof(T);
+    return true;
+}
+
+// A cache whose size and time match can still be damaged. Every index is
+// checked before Mesh::buildBlocks and the BVH traversals follow them:
+// vertices of the triangles, triangles of the leaves, leaf ranges, and
+// children that come after their parent, within the traversal depth.
+bool validMesh(const Mesh &mesh)
+{
+    for (unsigned int i = 0; i < mesh.m_triangles.size(); i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            if (mesh.m_triangles[i][j] >= mesh.m_positions.size()) return false;
+        }
+    }
+    const std::vector<unsigned int> &indices = mesh.m_bvh.indices;
+    for (unsigned int i = 0; i < indices.size(); i++)
+    {
+        if (indices[i] >= mesh.m_triangles.size()) return false;
+    }
+
+    const std::vector<BVHNode> &nodes = mesh.m_bvh.nodes;
+    std::vector<unsigned int> depth(nodes.size(), 0);
+    for (unsigned int n = 0; n < nodes.size(); n++)
+    {
+        const BVHNode &node = nodes[n];
+        if (node.count > 0)
+        {
+            if ((unsigned long long)node.offset + node.count > indices.size()) return false;
+            continue;
+        }
+        if (node.axis > 2 || n + 1 >= nodes.size() || node.offset <= n || node.offset >= nodes.size()) return false;
+        if (depth[n] + 1 > BVH::maxDepth) return false;
+        depth[n + 1] = std::max(depth[n + 1], depth[n] + 1);
+        depth[node.offset] = std::max(depth[node.offset], depth[n] + 1);
+    }
+    return true;
+}
+
+template <class T>
+void writeArray(std::ofstream &out, const std::vector<T> &array)
+{
+    if (!array.empty()) out.write((const char *)&array[0], array.size() * sizeof(T));
+}
+
+}
+
+bool MeshCache::read(Mesh &mesh, const std::string &meshPath)
+{
+    unsigned long long size;
+    long long mtime;
+    if (!MappedFile::stat(meshPath, size, mtime)) return false;
+
+    MappedFile file;
+    if (!file.open(cachePath(meshPath)) || file.size() < sizeof(MeshCacheHeader)) return false;
+
+    MeshCacheHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version ||
+        header.byteOrder != byteOrder || header.realSize != sizeof(real) ||
+        header.nodeSize != sizeof(BVHNode) ||
+        header.sourceSize != size || header.sourceMtime != mtime)
+    {
+        return false;
+    }
+
+    const char *p = file.data() + sizeof(header);
+    const char *end = file.data() + file.size();
+    if (!readArray(mesh.m_positions, header.numPositions, p, end) ||
+        !readArray(mesh.m_triangles, header.numTriangles, p, end) ||
+        !readArray(mesh.m_normals, header.numTriangles, p, end) ||
+        !readArray(mesh.m_bvh.nodes, header.numNodes, p, end) ||
+        !readArray(mesh.m_bvh.indices, header.numIndices, p, end) ||
+        !validMesh(mesh))
+    {
+        mesh.m_positions.clear();
+        mesh.m_triangles.clear();
+        mesh.m_normals.clear();
+        mesh.m_bvh = BVH();
+        return false;
+    }
+    return true;
+}
+
+bool MeshCache::write(const Mesh &mesh, const std::string &meshPath)
+{
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    if (!MappedFile::stat(meshPath, header.sourceSize, header.sourceMtime)) return false;
+
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byteOrder = byteOrder;
+    header.realSize = sizeof(real);
+    header.nodeSize = sizeof(BVHNode);
+    header.numPositions = mesh.m_positions.size();
+    header.numTriangles = mesh.m_triangles.size();
+    header.numNodes = mesh.m_bvh.nodes.size();
+    header.numIndices = mesh.m_bvh.indices.size();
+
+    // write next to the cache and rename, so a reader never sees half a
+    // file. The temporary name is per process, for concurrent loads.
+    std::string path = cachePath(meshPath);
+    std::ostringstream tmpName;
+    tmpName << path << "." << getpid() << ".tmp";
+    std::string tmpPath = tmpName.str();
+    std::ofstream out(tmpPath.c_str(), std::ios::binary);
+    if (!out) return false;
+    out.write((const char *)&header, sizeof(header));
+    writeArray(out, mesh.m_positions);
+    writeArray(out, mesh.m_triangles);
+    writeArray(out, mesh.m_normals);
+    writeArray(out, mesh.m_bvh.nodes);
+    writeArray(out, mesh.m_bvh.indices);
+    out.close();
+    if (!out)
+    {
+        remove(tmpPath.c_str());
+        return false;
+    }
+    return rename(tmpPath.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,37 @@
+//
+//  Framework for a raytracer
+//  File: meshcache.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <string>
+
+class Mesh;
+
+// Binary copy of a loaded mesh, stored next to the source model as
+// <model>.rtmesh: positions, triangles, normals and the BVH, all in model
+// space. It is only used while the size and modification time of the model
+// match the ones recorded in the cache, and when it was written by a build
+// with the same layout (endianness, precision).
+class MeshCache
+{
+public:
+    static std::string cachePath(const std::string &meshPath) { return meshPath + ".rtmesh"; }
+
+    static bool read(Mesh &mesh, const std::string &meshPath);
+    static bool write(const Mesh &mesh, const std::string &meshPath);
+};
+
+#endif /* end of include guard: MESHCACHE_H */
@@ -0,0 +1,861 @@
+//
+//  Framework for a raytracer
+//  File: meshloader.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "meshloader.h"
+#include "mappedfile.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+/************************** Parsing helpers **********************************/
+
+namespace {
+
+// files are only split in chunks of at least this size
+const size_t minChunkSize = 1 << 20;
+
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline const char* skipBlanks(const char *p, const char *end)
+{
+    while (p < end && isBlank(*p)) p++;
+    return p;
+}
+
+inline const char* nextLine(const char *p, const char *end)
+{
+    const char *n = (const char *)memchr(p, '\n', end - p);
+    return n ? n + 1 : end;
+}
+
+// neither empty nor a comment
+inline bool isDataLine(const char *p, const char *end)
+{
+    p = skipBlanks(p, end);
+    return p < end && *p != '\n' && *p != '#';
+}
+
+// skips white space, new lines and comments
+const char* skipToData(const char *p, const char *end)
+{
+    while (p < end && !isDataLine(p, end)) p = nextLine(p, end);
+    return skipBlanks(p, end);
+}
+
+// next word of the current line
+std::string parseWord(const char *&p, const char *end)
+{
+    p = skipBlanks(p, end);
+    const char *start = p;
+    while (p < end && !isBlank(*p) && *p != '\n') p++;
+    return std::string(start, p);
+}
+
+bool parseInt(const char *&p, const char *end, long long &value)
+{
+    p = skipBlanks(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+    if (p >= end || !isDigit(*p)) return false;
+
+    long long v = 0;
+    while (p < end && isDigit(*p))
+    {
+        v = v * 10 + (*p - '0');
+        p++;
+    }
+    value = negative ? -v : v;
+    return true;
+}
+
+// Decimal number with optional fraction and exponent. Digits after the 19th
+// significant one don't fit in the mantissa and only scale it.
+bool parseReal(const char *&p, const char *end, double &value)
+{
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    p = skipBlanks(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+
+    unsigned long long mantissa = 0;
+    int digits = 0;
+    long long exponent = 0;
+    bool any = false;
+    for (; p < end && isDigit(*p); p++, any = true)
+    {
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) digits++;
+        }
+        else
+        {
+            exponent++;
+        }
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && isDigit(*p); p++, any = true)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) digits++;
+                exponent--;
+            }
+        }
+    }
+    if (!any) return false;
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        long long e;
+        if (!parseInt(p, end, e)) return false;
+        exponent += std::max(-1000LL, std::min(1000LL, e));
+    }
+
+    double v = (double)mantissa;
+    if (v != 0)
+    {
+        for (; exponent > 22; exponent -= 22) v *= 1e22;
+        for (; exponent < -22; exponent += 22) v /= 1e22;
+        v = exponent < 0 ? v / powers[-exponent] : v * powers[exponent];
+    }
+    value = negative ? -v : v;
+    return true;
+}
+
+// Fan triangulation of a polygon, returns false for out of range indices
+bool addPolygon(const std::vector<long long> &polygon, unsigned long long numVertices,
+                std::vector<MeshTriangle> &triangles)
+{
+    for (unsigned int i = 0; i < polygon.size(); i++)
+    {
+        if (polygon[i] < 0 || (unsigned long long)polygon[i] >= numVertices) return false;
+    }
+    for (unsigned int i = 2; i < polygon.size(); i++)
+    {
+        triangles.push_back(MeshTriangle(polygon[0], polygon[i - 1], polygon[i]));
+    }
+    return true;
+}
+
+std::string lineError(unsigned long long line, const std::string &message)
+{
+    std::ostringstream s;
+    s << "line " << line << ": " << message;
+    return s.str();
+}
+
+/************************** Chunks **********************************/
+
+// Work done on every chunk of a file, possibly on several threads at once
+class ChunkJob
+{
+public:
+    virtual ~ChunkJob() { }
+    virtual void run(unsigned int chunk) = 0;
+};
+
+void runChunk(ChunkJob *job, unsigned int chunk)
+{
+    job->run(chunk);
+}
+
+void runChunks(ChunkJob &job, unsigned int count)
+{
+    if (count == 1)
+    {
+        job.run(0);
+        return;
+    }
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        threads.push_back(std::thread(runChunk, &job, i));
+    }
+    for (unsigned int i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+    }
+}
+
+unsigned int numChunks(size_t size)
+{
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    return std::min<size_t>(threads, size / minChunkSize + 1);
+}
+
+// Splits [begin, end) into chunks starting at the beginning of a line,
+// chunk i is [bounds[i], bounds[i + 1]).
+std::vector<const char*> splitLines(const char *begin, const char *end)
+{
+    unsigned int count = numChunks(end - begin);
+    std::vector<const char*> bounds(1, begin);
+    for (unsigned int i = 1; i < count; i++)
+    {
+        const char *p = nextLine(begin + (end - begin) * i / count - 1, end);
+        bounds.push_back(std::max(p, bounds.back()));
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+// Counts the lines of every chunk, and the ones accepted by the Counter
+template <class Counter>
+class LineCount : public ChunkJob
+{
+public:
+    LineCount(const std::vector<const char*> &bounds)
+        : bounds(bounds), lines(bounds.size() - 1, 0), counted(bounds.size() - 1, 0)
+    { }
+
+    void run(unsigned int chunk)
+    {
+        Counter counter;
+        const char *end = bounds[chunk + 1];
+        for (const char *p = bounds[chunk]; p < end; p = nextLine(p, end))
+        {
+            lines[chunk]++;
+            if (counter(p, end)) counted[chunk]++;
+        }
+    }
+
+    // turns the counts into the numbers of lines before every chunk
+    void prefixSums(unsigned long long firstLine)
+    {
+        unsigned long long l = firstLine, c = 0;
+        for (unsigned int i = 0; i < lines.size(); i++)
+        {
+            unsigned long long nl = lines[i], nc = counted[i];
+            lines[i] = l;
+            counted[i] = c;
+            l += nl;
+            c += nc;
+        }
+        totalCounted = c;
+    }
+
+    const std::vector<const char*> &bounds;
+    std::vector<unsigned long long> lines, counted;
+    unsigned long long totalCounted;
+};
+
+class DataLine
+{
+public:
+    bool operator()(const char *p, const char *end) { return isDataLine(p, end); }
+};
+
+class VertexLine
+{
+public:
+    bool operator()(const char *p, const char *end)
+    {
+        p = skipBlanks(p, end);
+        return end - p > 1 && p[0] == 'v' && isBlank(p[1]);
+    }
+};
+
+// Results of the second pass over the chunks, merged in chunk order
+class ChunkResults
+{
+public:
+    ChunkResults(unsigned int count) : triangles(count), errors(count) { }
+
+    bool merge(std::vector<MeshTriangle> &result, std::string &error)
+    {
+        for (unsigned int i = 0; i < errors.size(); i++)
+        {
+            if (!errors[i].empty())
+            {
+                error = errors[i];
+                return false;
+            }
+        }
+        size_t total = 0;
+        for (unsigned int i = 0; i < triangles.size(); i++) total += triangles[i].size();
+        result.clear();
+        result.reserve(total);
+        for (unsigned int i = 0; i < triangles.size(); i++)
+        {
+            result.insert(result.end(), triangles[i].begin(), triangles[i].end());
+        }
+        return true;
+    }
+
+    std::vector<std::vector<MeshTriangle> > triangles;
+    std::vector<std::string> errors;
+};
+
+/************************** OFF **********************************/
+
+// Data line L is vertex L up to numVertices, then face L - numVertices
+class OFFParse : public ChunkJob
+{
+public:
+    OFFParse(const LineCount<DataLine> &count, std::vector<Point> &positions,
+             unsigned long long numVertices, unsigned long long numFaces)
+        : count(count), positions(positions), numVertices(numVertices), numFaces(numFaces),
+          results(count.bounds.size() - 1)
+    { }
+
+    void run(unsigned int chunk)
+    {
+        const char *end = count.bounds[chunk + 1];
+        unsigned long long line = count.lines[chunk];
+        unsigned long long data = count.counted[chunk];
+        std::vector<long long> polygon;
+
+        for (const char *p = count.bounds[chunk]; p < end; p = nextLine(p, end), line++)
+        {
+            if (!isDataLine(p, end)) continue;
+            const char *q = p;
+
+            if (data < numVertices)
+            {
+                Point &v = positions[data];
+                if (!parseReal(q, end, v.x) || !parseReal(q, end, v.y) || !parseReal(q, end, v.z))
+                {
+                    results.errors[chunk] = lineError(line, "expected three vertex coordinates");
+                    return;
+                }
+            }
+            else if (data < numVertices + numFaces)
+            {
+                long long n;
+                if (!parseInt(q, end, n) || n < 3)
+                {
+                    results.errors[chunk] = lineError(line, "expected a polygon of at least three vertices");
+                    return;
+                }
+                // the indices are read as they come, so a bad count fails
+                // at the end of the line instead of allocating for it
+                polygon.clear();
+                for (long long i = 0; i < n; i++)
+                {
+                    long long index;
+                    if (!parseInt(q, end, index))
+                    {
+                        results.errors[chunk] = lineError(line, "expected a vertex index");
+                        return;
+                    }
+                    polygon.push_back(index);
+                }
+                if (!addPolygon(polygon, numVertices, results.triangles[chunk]))
+                {
+                    results.errors[chunk] = lineError(line, "vertex index out of range");
+                    return;
+                }
+            }
+            data++;
+        }
+    }
+
+    const LineCount<DataLine> &count;
+    std::vector<Point> &positions;
+    unsigned long long numVertices, numFaces;
+    ChunkResults results;
+};
+
+/************************** OBJ **********************************/
+
+// Reads v and f lines, everything else (normals, texture coordinates,
+// groups, materials) is ignored. Negative indices count back from the last
+// vertex read, which is why the vertices before every chunk are counted.
+class OBJParse : public ChunkJob
+{
+public:
+    OBJParse(const LineCount<VertexLine> &count, std::vector<Point> &positions)
+        : count(count), positions(positions), results(count.bounds.size() - 1)
+    { }
+
+    void run(unsigned int chunk)
+    {
+        const char *end = count.bounds[chunk + 1];
+        unsigned long long line = count.lines[chunk];
+        unsigned long long vertex = count.counted[chunk];
+        std::vector<long long> polygon;
+
+        for (const char *p = count.bounds[chunk]; p < end; p = nextLine(p, end), line++)
+        {
+            const char *q = skipBlanks(p, end);
+            if (end - q < 2 || !isBlank(q[1])) continue;
+
+            if (q[0] == 'v')
+            {
+                q++;
+                Point &v = positions[vertex++];
+                if (!parseReal(q, end, v.x) || !parseReal(q, end, v.y) || !parseReal(q, end, v.z))
+                {
+                    results.errors[chunk] = lineError(line, "expected three vertex coordinates");
+                    return;
+                }
+            }
+            else if (q[0] == 'f')
+            {
+                q++;
+                polygon.clear();
+                long long index;
+                while (parseInt(q, end, index))
+                {
+                    if (index == 0)
+                    {
+                        results.errors[chunk] = lineError(line, "vertex index 0");
+                        return;
+                    }
+                    polygon.push_back(index > 0 ? index - 1 : (long long)vertex + index);
+                    // skip the texture coordinate and normal indices
+                    while (q < end && !isBlank(*q) && *q != '\n') q++;
+                }
+                if (polygon.size() < 3)
+                {
+                    results.errors[chunk] = lineError(line, "expected a polygon of at least three vertices");
+                    return;
+                }
+                if (!addPolygon(polygon, positions.size(), results.triangles[chunk]))
+                {
+                    results.errors[chunk] = lineError(line, "vertex index out of range");
+                    return;
+                }
+            }
+        }
+    }
+
+    const LineCount<VertexLine> &count;
+    std::vector<Point> &positions;
+    ChunkResults results;
+};
+
+/************************** PLY **********************************/
+
+enum PLYType { PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64, PLY_INVALID };
+
+const unsigned int plyTypeSize[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+PLYType plyType(const std::string &name)
+{
+    if (name == "char" || name == "int8") return PLY_INT8;
+    if (name == "uchar" || name == "uint8") return PLY_UINT8;
+    if (name == "short" || name == "int16") return PLY_INT16;
+    if (name == "ushort" || name == "uint16") return PLY_UINT16;
+    if (name == "int" || name == "int32") return PLY_INT32;
+    if (name == "uint" || name == "uint32") return PLY_UINT32;
+    if (name == "float" || name == "float32") return PLY_FLOAT32;
+    if (name == "double" || name == "float64") return PLY_FLOAT64;
+    return PLY_INVALID;
+}
+
+class PLYProperty
+{
+public:
+    std::string name;
+    PLYType type;
+    bool list;
+    PLYType countType;
+};
+
+class PLYElement
+{
+public:
+    std::string name;
+    unsigned long long count;
+    std::vector<PLYProperty> properties;
+
+    int find(const std::string &property) const
+    {
+        for (unsigned int i = 0; i < properties.size(); i++)
+        {
+            if (properties[i].name == property) return i;
+        }
+        return -1;
+    }
+};
+
+// Reads a binary value, swapping the bytes when the file and the machine
+// don't agree on the byte order
+double readBinary(const char *p, PLYType type, bool swap)
+{
+    unsigned char bytes[8];
+    unsigned int size = plyTypeSize[type];
+    for (unsigned int i = 0; i < size; i++)
+    {
+        bytes[i] = p[swap ? size - 1 - i : i];
+    }
+
+    switch (type)
+    {
+    case PLY_INT8:    { signed char v;     memcpy(&v, bytes, 1); return v; }
+    case PLY_UINT8:   { unsigned char v;   memcpy(&v, bytes, 1); return v; }
+    case PLY_INT16:   { short v;           memcpy(&v, bytes, 2); return v; }
+    case PLY_UINT16:  { unsigned short v;  memcpy(&v, bytes, 2); return v; }
+    case PLY_INT32:   { int v;             memcpy(&v, bytes, 4); return v; }
+    case PLY_UINT32:  { unsigned int v;    memcpy(&v, bytes, 4); return v; }
+    case PLY_FLOAT32: { float v;           memcpy(&v, bytes, 4); return v; }
+    case PLY_FLOAT64: { double v;          memcpy(&v, bytes, 8); return v; }
+    default: return 0;
+    }
+}
+
+// Reads one value of a property (the count for a list), binary or ascii
+bool readValue(const char *&p, const char *end, PLYType type, bool binary, bool swap, double &value)
+{
+    if (!binary)
+    {
+        p = skipToData(p, end);
+        return parseReal(p, end, value);
+    }
+    if ((size_t)(end - p) < plyTypeSize[type]) return false;
+    value = readBinary(p, type, swap);
+    p += plyTypeSize[type];
+    return true;
+}
+
+// Vertices with fixed size records, parsed in parallel
+class PLYVertexParse : public ChunkJob
+{
+public:
+    PLYVertexParse(const char *data, unsigned int stride, const int *offsets, const PLYType *types,
+                   bool swap, std::vector<Point> &positions)
+        : data(data), stride(stride), offsets(offsets), types(types), swap(swap), positions(positions),
+          chunks(numChunks(positions.size() * stride))
+    { }
+
+    void run(unsigned int chunk)
+    {
+        size_t begin = positions.size() * chunk / chunks;
+        size_t end = positions.size() * (chunk + 1) / chunks;
+        for (size_t i = begin; i < end; i++)
+        {
+            const char *record = data + i * stride;
+            for (int j = 0; j < 3; j++)
+            {
+                positions[i].data[j] = readBinary(record + offsets[j], types[j], swap);
+            }
+        }
+    }
+
+    const char *data;
+    unsigned int stride;
+    const int *offsets;
+    const PLYType *types;
+    bool swap;
+    std::vector<Point> &positions;
+    unsigned int chunks;
+};
+
+}
+
+/************************** MeshLoader **********************************/
+
+bool MeshLoader::load(const std::string &path, std::vector<Point> &positions,
+                      std::vector<MeshTriangle> &triangles, std::string &error)
+{
+    MappedFile file;
+    if (!file.open(path))
+    {
+        error = "unable to open " + path + " for reading";
+        return false;
+    }
+    const char *begin = file.data();
+    const char *end = begin + file.size();
+
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    bool ok;
+    if (extension == "obj")
+    {
+        ok = loadOBJ(begin, end, positions, triangles, error);
+    }
+    else if (extension == "ply")
+    {
+        ok = loadPLY(begin, end, positions, triangles, error);
+    }
+    else
+    {
+        ok = loadOFF(begin, end, positions, triangles, error);
+    }
+
+    if (!ok) error = path + ": " + error;
+    return ok;
+}
+
+bool MeshLoader::loadOFF(const char *begin, const char *end, std::vector<Point> &positions,
+                         std::vector<MeshTriangle> &triangles, std::string &error)
+{
+    // header: the OFF keyword (COFF, NOFF... are read as OFF) and the vertex,
+    // face and edge counts, possibly on the next line
+    const char *p = skipToData(begin, end);
+    std::string keyword = parseWord(p, end);
+    if (keyword.size() < 3 || keyword.compare(keyword.size() - 3, 3, "OFF") != 0)
+    {
+        error = "not an OFF file";
+        return false;
+    }
+    long long numVertices, numFaces;
+    p = skipToData(p, end);
+    if (!parseInt(p, end, numVertices) || !parseInt(p, end, numFaces) || numVertices < 0 || numFaces < 0)
+    {
+        error = "expected the vertex and face counts";
+        return false;
+    }
+    p = nextLine(p, end);
+
+    unsigned long long firstLine = 1 + std::count(begin, p, '\n');
+    std::vector<const char*> bounds = splitLines(p, end);
+    LineCount<DataLine> count(bounds);
+    runChunks(count, bounds.size() - 1);
+    count.prefixSums(firstLine);
+
+    if (count.totalCounted < (unsigned long long)(numVertices + numFaces))
+    {
+        error = "unexpected end of file";
+        return false;
+    }
+
+    positions.resize(numVertices);
+    OFFParse parse(count, positions, numVertices, numFaces);
+    runChunks(parse, bounds.size() - 1);
+    return parse.results.merge(triangles, error);
+}
+
+bool MeshLoader::loadOBJ(const char *begin, const char *end, std::vector<Point> &positions,
+                         std::vector<MeshTriangle> &triangles, std::string &error)
+{
+    std::vector<const char*> bounds = splitLines(begin, end);
+    LineCount<VertexLine> count(bounds);
+    runChunks(count, bounds.size() - 1);
+    count.prefixSums(1);
+
+    positions.resize(count.totalCounted);
+    OBJParse parse(count, positions);
+    runChunks(parse, bounds.size() - 1);
+    return parse.results.merge(triangles, error);
+}
+
+bool MeshLoader::loadPLY(const char *begin, const char *end, std::vector<Point> &positions,
+                         std::vector<MeshTriangle> &triangles, std::string &error)
+{
+    const char *p = begin;
+    if (parseWord(p, end) != "ply")
+    {
+        error = "not a PLY file";
+        return false;
+    }
+
+    bool binary = false, bigEndian = false;
+    std::vector<PLYElement> elements;
+    for (p = nextLine(p, end); ; p = nextLine(p, end))
+    {
+        if (p >= end)
+        {
+            error = "missing end_header";
+            return false;
+        }
+        std::string keyword = parseWord(p, end);
+        if (keyword == "end_header")
+        {
+            p = nextLine(p, end);
+            break;
+        }
+        else if (keyword == "format")
+        {
+            std::string format = parseWord(p, end);
+            binary = format != "ascii";
+            bigEndian = format == "binary_big_endian";
+            if (binary && !bigEndian && format != "binary_little_endian")
+            {
+                error = "unknown format " + format;
+                return false;
+            }
+        }
+        else if (keyword == "element")
+        {
+            PLYElement element;
+            element.name = parseWord(p, end);
+            long long n;
+            if (!parseInt(p, end, n) || n < 0)
+            {
+                error = "expected an element count";
+                return false;
+            }
+            element.count = n;
+            elements.push_back(element);
+        }
+        else if (keyword == "property")
+        {
+            if (elements.empty())
+            {
+                error = "property outside of an element";
+                return false;
+            }
+            PLYProperty property;
+            std::string type = parseWord(p, end);
+            property.list = type == "list";
+            property.countType = PLY_INVALID;
+            if (property.list)
+            {
+                property.countType = plyType(parseWord(p, end));
+                type = parseWord(p, end);
+            }
+            property.type = plyType(type);
+            property.name = parseWord(p, end);
+            if (property.type == PLY_INVALID || (property.list && property.countType == PLY_INVALID))
+            {
+                error = "unknown type of property " + property.name;
+                return false;
+            }
+            elements.back().properties.push_back(property);
+        }
+        // comment, obj_info and anything else are skipped
+    }
+
+    unsigned int one = 1;
+    bool swap = binary && bigEndian != (*(unsigned char *)&one == 0);
+
+    for (unsigned int e = 0; e < elements.size(); e++)
+    {
+        const PLYElement &element = elements[e];
+        int coordinates[3] = { element.find("x"), element.find("y"), element.find("z") };
+        int indices = element.find("vertex_indices");
+        if (indices < 0) indices = element.find("vertex_index");
+
+        bool isVertex = element.name == "vertex";
+        bool isFace = element.name == "face";
+        if (isVertex)
+        {
+            if (coordinates[0] < 0 || coordinates[1] < 0 || coordinates[2] < 0)
+            {
+                error = "vertices without x, y and z";
+                return false;
+            }
+            positions.resize(element.count);
+        }
+        if (isFace && (indices < 0 || !element.properties[indices].list))
+        {
+            error = "faces without vertex_indices";
+            return false;
+        }
+
+        // fixed size binary vertices are parsed in parallel
+        bool fixedSize = binary;
+        int offsets[3];
+        PLYType types[3];
+        unsigned int stride = 0;
+        for (unsigned int i = 0; i < element.properties.size(); i++)
+        {
+            const PLYProperty &property = element.properties[i];
+            if (property.list) fixedSize = false;
+            for (int j = 0; j < 3; j++)
+            {
+                if (coordinates[j] == (int)i)
+                {
+                    offsets[j] = stride;
+                    types[j] = property.type;
+                }
+            }
+            stride += plyTypeSize[property.type];
+        }
+        if (isVertex && fixedSize)
+        {
+            if ((unsigned long long)(end - p) < element.count * stride)
+            {
+                error = "unexpected end of file";
+                return false;
+            }
+            PLYVertexParse parse(p, stride, offsets, types, swap, positions);
+            runChunks(parse, parse.chunks);
+            p += element.count * stride;
+            continue;
+        }
+
+        // everything else is read one value at a time
+        std::vector<long long> polygon;
+        for (unsigned long long item = 0; item < element.count; item++)
+        {
+            for (unsigned int i = 0; i < element.properties.size(); i++)
+            {
+                const PLYProperty &property = element.properties[i];
+                double value;
+                if (!readValue(p, end, property.list ? property.countType : property.type, binary, swap, value))
+                {
+                    error = "unexpected end of file";
+                    return false;
+                }
+
+                if (!property.list)
+                {
+                    for (int j = 0; j < 3; j++)
+                    {
+                        if (isVertex && coordinates[j] == (int)i) positions[item].data[j] = value;
+                    }
+                    continue;
+                }
+
+                // a bad count fails at the end of the file instead of
+                // allocating for it
+                unsigned long long n = (unsigned long long)value;
+                if (isFace && (int)i == indices) polygon.clear();
+                for (unsigned long long k = 0; k < n; k++)
+                {
+                    if (!readValue(p, end, property.type, binary, swap, value))
+                    {
+                        error = "unexpected end of file";
+                        return false;
+                    }
+                    if (isFace && (int)i == indices) polygon.push_back((long long)value);
+                }
+            }
+
+            if (isFace)
+            {
+                if (polygon.size() < 3)
+                {
+                    error = "face with less than three vertices";
+                    return false;
+                }
+                if (!addPolygon(polygon, positions.size(), triangles))
+                {
+                    error = "vertex index out of range";
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,43 @@
+//
+//  Framework for a raytracer
+//  File: meshloader.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef MESHLOADER_H
+#define MESHLOADER_H
+
+#include <string>
+#include <vector>
+#include "triple.h"
+#include "meshtriangle.h"
+
+// Reads OFF, OBJ and PLY (ascii or binary) models, chosen by file
+// extension. The file is mapped in memory and split into chunks of lines
+// that are parsed by several threads. Polygons with more than three
+// vertices are triangulated as fans. On failure, error says what went wrong.
+class MeshLoader
+{
+public:
+    static bool load(const std::string &path, std::vector<Point> &positions,
+                     std::vector<MeshTriangle> &triangles, std::string &error);
+
+private:
+    static bool loadOFF(const char *begin, const char *end, std::vector<Point> &positions,
+                        std::vector<MeshTriangle> &triangles, std::string &error);
+    static bool loadOBJ(const char *begin, const char *end, std::vector<Point> &positions,
+                        std::vector<MeshTriangle> &triangles, std::string &error);
+    static bool loadPLY(const char *begin, const char *end, std::vector<Point> &positions,
+                        std::vector<MeshTriangle> &triangles, std::string &error);
+};
+
+#endif /* end of include guard: MESHLOADER_H */
@@ -19,6 +19,9 @@
 
 #include "triple.h"
 #include "light.h"
+#include "bbox.h"
+#include "raypacket.h"
+#include "stats.h"
 
 class Material;
 
@@ -26,10 +29,48 @@ class Object {
 public:
     Material *material;
     float angle;
+    Stats::Counter tests;   // counts the intersection tests against this kind of object
 
-    virtual ~Object() { }
+    Object(Stats::Counter tests = Stats::OtherTests) : tests(tests) { }
 
     virtual Hit intersect(const Ray &ray) = 0;
+
+    // Normal at a hit returned by intersect for the same ray
+    virtual Vector normal(const Ray &ray, const Hit &hit) const = 0;
+
+    // Shadow ray query: is anything hit before tMax? Only needs to find one
+    // blocker, so overrides skip the closest hit search and the normal.
+    virtual bool occluded(const Ray &ray, double tMax)
+    {
+        Hit hit(intersect(ray));
+        return !hit.no_hit && hit.t < tMax;
+    }
+
+    // Updates the lanes of the packet for which this object is closer than
+    // their current hit. Primitives with a SIMD kernel override this.
+    virtual void intersectPacket(RayPacket &packet)
+    {
+        for (unsigned int i = 0; i < RayPacket::size; i++)
+        {
+            if (!packet.rays[i]) continue;
+            Hit hit(intersect(*packet.rays[i]));
+            if (!hit.no_hit && hit.t < packet.t[i])
+            {
+                packet.t[i] = hit.t;
+                packet.obj[i] = this;
+            }
+        }
+    }
+
+    // Bounds used to build the scene BVH. Objects without a finite extent
+    // keep the default and are tested against every ray.
+    virtual BBox bounds() const { return BBox::infinite(); }
+
+protected:
+    // Objects belong to the Arena of their scene, which destroys them with
+    // their own type, never through an Object pointer. A trivial destructor
+    // lets the primitives be freed without running any code.
+    ~Object() = default;
 };
 
 #endif /* end of include guard: OBJECT_H_AXKLE0OF */
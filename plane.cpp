@@ -30,8 +30,36 @@ Hit Plane::intersect(const Ray &ray)
 
     if(t >= 0)
     {
-        return Hit(t, n);
+        return Hit(t);
     }
 
     return Hit::NO_HIT();
-}
\ No newline at end of file
+}
+
+Vector Plane::normal(const Ray &ray, const Hit &hit) const
+{
+    return n;
+}
+
+bool Plane::occluded(const Ray &ray, double tMax)
+{
+    float t = (d - n.dot(ray.O)) / n.dot(ray.D);
+    return t >= 0 && t < tMax;
+}
+
+void Plane::intersectPacket(RayPacket &packet)
+{
+#ifdef __SSE2__
+    // intersect for four rays at once
+    __m128 nO = packetDot(_mm_set1_ps(n.x), _mm_set1_ps(n.y), _mm_set1_ps(n.z),
+                          _mm_load_ps(packet.ox), _mm_load_ps(packet.oy), _mm_load_ps(packet.oz));
+    __m128 nD = packetDot(_mm_set1_ps(n.x), _mm_set1_ps(n.y), _mm_set1_ps(n.z),
+                          _mm_load_ps(packet.dx), _mm_load_ps(packet.dy), _mm_load_ps(packet.dz));
+    __m128 t = _mm_div_ps(_mm_sub_ps(_mm_set1_ps(d), nO), nD);
+
+    __m128 hit = _mm_cmpge_ps(t, _mm_setzero_ps());
+    packet.update(t, _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_load_ps(packet.t))), this);
+#else
+    Object::intersectPacket(packet);
+#endif
+}
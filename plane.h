@@ -23,9 +23,12 @@
 class Plane : public Object
 {
 public:
-    Plane(float d, Vector n) : d(d), n(n) { }
+    Plane(float d, Vector n) : Object(Stats::PlaneTests), d(d), n(n) { }
 
     virtual Hit intersect(const Ray &ray);
+    virtual Vector normal(const Ray &ray, const Hit &hit) const;
+    virtual bool occluded(const Ray &ray, double tMax);
+    virtual void intersectPacket(RayPacket &packet);
 
     const float d;
     const Vector n;
@@ -20,38 +20,40 @@
 
 /************************** Quad **********************************/
 
-Hit Quad::intersect(const Ray &ray)
+Quad::Quad(Point a, Point b, Point c, Point d)
+    : Object(Stats::QuadTests), a(a), b(b), c(c), d(d), ab(b - a), ac(c - a), ad(d - a)
 {
-    // http://www.r-5.org/files/books/computers/algo-list/realtime-3d/Christer_Ericson-Real-Time_Collision_Detection-EN.pdf
-    // section 5.3.5
+    n1 = ab.cross(ac);
+    n2 = ac.cross(ad);
 
-    Triangle t1(a, b, c);
-    Triangle t2(a, c, d);
+    n = ab.cross(ad) + (b - c).cross(d - c) / 2.0;
+    n = n.normalized();
+}
 
-    Vector e1 = b - a;
-    Vector e2 = d - a;
-    Vector n1 = e1.cross(e2);
+Hit Quad::intersect(const Ray &ray)
+{
+    double t, u, v;
+    if(Triangle::intersect(ray, a, ab, ac, n1, t, u, v) && t >= 0.0) return Hit(t, 0, u, v);
+    if(Triangle::intersect(ray, a, ac, ad, n2, t, u, v) && t >= 0.0) return Hit(t, 1, u, v);
+    return Hit::NO_HIT();
+}
 
-    e1 = b - c;
-    e2 = d - c;
-    Vector n2 = e1.cross(e2);
+Vector Quad::normal(const Ray &ray, const Hit &hit) const
+{
+    return n;
+}
 
-    Vector n = n1 + n2 / 2.0;
-    n = n.normalized();
+bool Quad::occluded(const Ray &ray, double tMax)
+{
+    double t, u, v;
+    return (Triangle::intersect(ray, a, ab, ac, n1, t, u, v) && t >= 0.0 && t < tMax)
+        || (Triangle::intersect(ray, a, ac, ad, n2, t, u, v) && t >= 0.0 && t < tMax);
+}
 
-    const Hit h1 = t1.intersect(ray);
-    const Hit h2 = t2.intersect(ray);
-
-    if(!h1.no_hit)
-    {
-        return Hit(h1.t, n);
-    }
-    else if(!h2.no_hit)
-    {
-        return Hit(h2.t, n);
-    }
-    else
-    { 
-        return Hit::NO_HIT();
-    }
-}
\ No newline at end of file
+BBox Quad::bounds() const
+{
+    BBox box(a, b);
+    box.extend(c);
+    box.extend(d);
+    return box;
+}
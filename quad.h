@@ -21,11 +21,20 @@
 class Quad : public Object
 {
 public:
-    Quad(Point a, Point b, Point c, Point d) : a(a), b(b), c(c), d(d) { }
+    Quad(Point a, Point b, Point c, Point d);
 
     virtual Hit intersect(const Ray &ray);
+    virtual Vector normal(const Ray &ray, const Hit &hit) const;
+    virtual bool occluded(const Ray &ray, double tMax);
+    virtual BBox bounds() const;
 
     const Point a, b, c, d;
+
+private:
+    // the triangles a, b, c and a, c, d, see Triangle::intersect
+    Vector ab, ac, ad;
+    Vector n1, n2;
+    Vector n;           // shading normal
 };
 
 #endif /* end of include guard: QUAD_H */
\ No newline at end of file
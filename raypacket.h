@@ -0,0 +1,158 @@
+//
+//  Framework for a raytracer
+//  File: raypacket.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef RAYPACKET_H
+#define RAYPACKET_H
+
+#include <algorithm>
+#include "triple.h"
+#include "light.h"
+#include "vec3.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+class Object;
+
+// A bundle of coherent rays traced together, one ray per SSE lane. The rays
+// are stored as structure of arrays in single precision for the packet
+// kernels; rays[] keeps the original rays, NULL marks an inactive lane.
+// The packet only finds the closest object of every lane, the shading is
+// done on the single rays.
+class RayPacket
+{
+public:
+    static const unsigned int size = 4;
+
+    RayPacket()
+    {
+        for (unsigned int i = 0; i < size; i++)
+        {
+            rays[i] = NULL;
+            obj[i] = NULL;
+            ox[i] = oy[i] = oz[i] = 0;
+            dx[i] = dy[i] = dz[i] = 1;
+            idx[i] = idy[i] = idz[i] = 1;
+            // inactive lanes can't get any closer than this
+            t[i] = -1;
+        }
+    }
+
+    void set(unsigned int lane, const Ray &ray)
+    {
+        rays[lane] = &ray;
+        ox[lane] = ray.O.x; oy[lane] = ray.O.y; oz[lane] = ray.O.z;
+        dx[lane] = ray.D.x; dy[lane] = ray.D.y; dz[lane] = ray.D.z;
+        idx[lane] = 1.0f / dx[lane]; idy[lane] = 1.0f / dy[lane]; idz[lane] = 1.0f / dz[lane];
+        t[lane] = std::numeric_limits<float>::infinity();
+    }
+
+    // lane mask of the rays that reach the box before their current hit
+    int hitsBox(const Vec3 &min, const Vec3 &max) const;
+
+#ifdef __SSE2__
+    // stores the distances of the lanes selected by mask and marks them as
+    // hitting o, used by the SIMD kernels of the primitives
+    void update(__m128 tHit, __m128 mask, Object *o)
+    {
+        __m128 old = _mm_load_ps(t);
+        _mm_store_ps(t, _mm_or_ps(_mm_and_ps(mask, tHit), _mm_andnot_ps(mask, old)));
+        int bits = _mm_movemask_ps(mask);
+        for (unsigned int i = 0; i < size; i++)
+        {
+            if (bits & (1 << i)) obj[i] = o;
+        }
+    }
+#endif
+
+    // direction sign of the first active ray, used to order the traversal
+    bool negativeDir(unsigned int axis) const
+    {
+        const float *d[3] = { dx, dy, dz };
+        for (unsigned int i = 0; i < size; i++)
+        {
+            if (rays[i]) return d[axis][i] < 0;
+        }
+        return false;
+    }
+
+    const Ray *rays[size];
+    Object *obj[size];
+
+    float ox[size] __attribute__((aligned(16)));
+    float oy[size] __attribute__((aligned(16)));
+    float oz[size] __attribute__((aligned(16)));
+    float dx[size] __attribute__((aligned(16)));
+    float dy[size] __attribute__((aligned(16)));
+    float dz[size] __attribute__((aligned(16)));
+    float idx[size] __attribute__((aligned(16)));
+    float idy[size] __attribute__((aligned(16)));
+    float idz[size] __attribute__((aligned(16)));
+    float t[size] __attribute__((aligned(16)));
+};
+
+inline int RayPacket::hitsBox(const Vec3 &min, const Vec3 &max) const
+{
+#ifdef __SSE2__
+    __m128 t0 = _mm_setzero_ps();
+    __m128 t1 = _mm_load_ps(t);
+
+    const float *o[3] = { ox, oy, oz };
+    const float *id[3] = { idx, idy, idz };
+    for (int i = 0; i < 3; i++)
+    {
+        __m128 origin = _mm_load_ps(o[i]);
+        __m128 inv = _mm_load_ps(id[i]);
+        __m128 tA = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(min[i]), origin), inv);
+        __m128 tB = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(max[i]), origin), inv);
+        t0 = _mm_max_ps(t0, _mm_min_ps(tA, tB));
+        t1 = _mm_min_ps(t1, _mm_max_ps(tA, tB));
+    }
+    return _mm_movemask_ps(_mm_cmple_ps(t0, t1));
+#else
+    int mask = 0;
+    const float *o[3] = { ox, oy, oz };
+    const float *id[3] = { idx, idy, idz };
+    for (unsigned int lane = 0; lane < size; lane++)
+    {
+        float t0 = 0, t1 = t[lane];
+        for (int i = 0; i < 3; i++)
+        {
+            float tA = (min[i] - o[i][lane]) * id[i][lane];
+            float tB = (max[i] - o[i][lane]) * id[i][lane];
+            if (tA > tB) std::swap(tA, tB);
+            if (tA > t0) t0 = tA;
+            if (tB < t1) t1 = tB;
+        }
+        if (t0 <= t1) mask |= 1 << lane;
+    }
+    return mask;
+#endif
+}
+
+// Relative slack of the single precision packet kernels, so they don't miss
+// hits the double precision tests find
+const float packetEpsilon = 1e-4f;
+
+#ifdef __SSE2__
+// Helper for the packet kernels, vectors are given as x, y, z lanes.
+inline __m128 packetDot(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+#endif
+
+#endif /* end of include guard: RAYPACKET_H */
@@ -23,10 +23,15 @@
 #include "light.h"
 #include "camera.h"
 #include "image.h"
+#include "stats.h"
 #include "yaml/yaml.h"
 #include <ctype.h>
 #include <fstream>
 #include <assert.h>
+#include <stdexcept>
+#include <atomic>
+#include <cstdio>
+#include <thread>
 
 // Functions to ease reading from YAML input
 void operator >> (const YAML::Node& node, Triple& t);
@@ -51,13 +56,19 @@ Triple parseTriple(const YAML::Node& node)
 
 Material* Raytracer::parseMaterial(const YAML::Node& node)
 {
-    Material *m = new Material();
+    Arena &arena = scene->getArena();
+    Material *m = arena.create<Material>();
 
     if (node.FindValue("texture"))
     {
         std::string texturePath;
         node["texture"] >> texturePath;
-        Image* tex = new Image(texturePath.c_str());
+        Image* tex;
+        {
+            PhaseTimer timer(Stats::TexturePhase);
+            tex = arena.create<Image>(texturePath.c_str());
+            if (options.textureFilter == RenderOptions::Trilinear) tex->buildMipmaps();
+        }
 
         if(tex->width() == 0 && tex->height() == 0)
         {
@@ -79,6 +90,7 @@ Material* Raytracer::parseMaterial(const YAML::Node& node)
 
 Object* Raytracer::parseObject(const YAML::Node& node)
 {
+    Arena &arena = scene->getArena();
     Object *returnObject = NULL;
     std::string objectType;
     node["type"] >> objectType;
@@ -88,7 +100,7 @@ Object* Raytracer::parseObject(const YAML::Node& node)
         node["position"] >> pos;
         double r;
         node["radius"] >> r;
-        Sphere *sphere = new Sphere(pos,r);		
+        Sphere *sphere = arena.create<Sphere>(pos,r);		
         returnObject = sphere;
     }
     else if(objectType == "triangle")
@@ -97,7 +109,7 @@ Object* Raytracer::parseObject(const YAML::Node& node)
         node["a"] >> a;
         node["b"] >> b;
         node["c"] >> c;
-        Triangle *triangle = new Triangle(a, b, c);
+        Triangle *triangle = arena.create<Triangle>(a, b, c);
         returnObject = triangle;
     }
     else if(objectType == "plane")
@@ -106,7 +118,7 @@ Object* Raytracer::parseObject(const YAML::Node& node)
         Vector n;
         node["d"] >> d;
         node["n"] >> n;
-        Plane *plane = new Plane(d, n);
+        Plane *plane = arena.create<Plane>(d, n);
         returnObject = plane;
     }
     else if(objectType == "quad")
@@ -116,18 +128,46 @@ Object* Raytracer::parseObject(const YAML::Node& node)
         b = parseTriple(node["b"]);
         c = parseTriple(node["c"]);
         d = parseTriple(node["d"]);
-        Quad *quad = new Quad(a, b, c, d);
+        Quad *quad = arena.create<Quad>(a, b, c, d);
         returnObject = quad;
     }
     else if(objectType == "mesh")
     {
         std::string meshPath;
         node["path"] >> meshPath;
-        Mesh *mesh = new Mesh(meshPath);
+        // the binary cache next to the model can be turned off with cache: false
+        bool useCache = !node.FindValue("cache") || !(node["cache"] == "false");
+        PhaseTimer timer(Stats::MeshPhase);
+        Mesh *mesh = arena.create<Mesh>(meshPath, useCache);
         mesh->position = parseTriple(node["position"]);
         node["size"] >> mesh->size;
         //mesh->recomputeNormals();
         mesh->scaleTranslate();
+        mesh->buildBlocks();
+        returnObject = mesh;
+    }
+    else if(objectType == "tessellated")
+    {
+        // generated mesh: a sphere or a terrain of the given resolution
+        std::string shape;
+        node["shape"] >> shape;
+        unsigned int resolution;
+        node["resolution"] >> resolution;
+        unsigned int seed = 1;
+        if (node.FindValue("seed")) node["seed"] >> seed;
+        Random random(seed);
+
+        PhaseTimer timer(Stats::MeshPhase);
+        Mesh *mesh = NULL;
+        if (shape == "sphere") mesh = Generator::tessellatedSphere(arena, resolution);
+        else if (shape == "terrain") mesh = Generator::terrain(arena, resolution, random);
+        if (mesh) {
+            mesh->position = parseTriple(node["position"]);
+            node["size"] >> mesh->size;
+            mesh->scaleTranslate();
+            mesh->buildBlocks();
+            cout << "Generated " << shape << " mesh: " << mesh->m_triangles.size() << " triangles" << endl;
+        }
         returnObject = mesh;
     }
 
@@ -151,7 +191,86 @@ Light* Raytracer::parseLight(const YAML::Node& node)
     node["position"] >> position;
     Color color;
     node["color"] >> color;
-    return new Light(position,color);
+    // optional, the light fades out and has no effect beyond its radius
+    double radius = 0;
+    if (node.FindValue("radius")) node["radius"] >> radius;
+    return scene->getArena().create<Light>(position,color,radius);
+}
+
+Distribution Raytracer::parseDistribution(const YAML::Node& node, Random& random)
+{
+    Point min = parseTriple(node["min"]);
+    Point max = parseTriple(node["max"]);
+    if (node.FindValue("distribution") && node["distribution"] == "clustered") {
+        unsigned int clusters;
+        double spread;
+        node["clusters"] >> clusters;
+        node["spread"] >> spread;
+        return Distribution(min, max, clusters, spread, random);
+    }
+    return Distribution(min, max);
+}
+
+// Objects of type random: count spheres, triangles or quads placed by a
+// distribution, with a size in the given range. They share one material
+// unless randomColors is set.
+void Raytracer::parseRandomObjects(const YAML::Node& node)
+{
+    std::string shape;
+    node["shape"] >> shape;
+    unsigned int count, seed = 1;
+    node["count"] >> count;
+    if (node.FindValue("seed")) node["seed"] >> seed;
+    double minSize, maxSize;
+    node["size"][0] >> minSize;
+    node["size"][1] >> maxSize;
+    bool randomColors = node.FindValue("randomColors") && node["randomColors"] == "true";
+
+    Random random(seed);
+    Distribution distribution = parseDistribution(node, random);
+    Material *material = parseMaterial(node["material"]);
+    Arena &arena = scene->getArena();
+
+    for (unsigned int i = 0; i < count; i++) {
+        Point center = distribution(random);
+        double size = random.range(minSize, maxSize);
+        Object *obj = NULL;
+        if (shape == "sphere") obj = Generator::sphere(arena, center, size);
+        else if (shape == "triangle") obj = Generator::triangle(arena, center, size, random);
+        else if (shape == "quad") obj = Generator::quad(arena, center, size, random);
+        if (!obj) {
+            cerr << "Warning: random objects of unknown shape " << shape << ", ignored." << endl;
+            return;
+        }
+
+        obj->material = material;
+        if (randomColors) {
+            obj->material = arena.create<Material>(*material);
+            obj->material->color = Color(random(), random(), random());
+        }
+        obj->angle = 0;
+        scene->addObject(obj);
+    }
+    cout << "Generated " << count << " random " << shape << " objects" << endl;
+}
+
+// Lights with a count are count random lights of the given color
+void Raytracer::parseRandomLights(const YAML::Node& node)
+{
+    unsigned int count, seed = 1;
+    node["count"] >> count;
+    if (node.FindValue("seed")) node["seed"] >> seed;
+    Color color;
+    node["color"] >> color;
+    double radius = 0;
+    if (node.FindValue("radius")) node["radius"] >> radius;
+
+    Random random(seed);
+    Distribution distribution = parseDistribution(node, random);
+    Arena &arena = scene->getArena();
+    for (unsigned int i = 0; i < count; i++) {
+        scene->addLight(arena.create<Light>(distribution(random), color, radius));
+    }
 }
 
 Camera* Raytracer::parseCamera(const YAML::Node& node)
@@ -175,37 +294,119 @@ Camera* Raytracer::parseCamera(const YAML::Node& node)
 
 bool Raytracer::readScene(const std::string& inputFilename)
 {
-    // Initialize a new scene
-    scene = new Scene();
-
     // Open file stream for reading and have the YAML module parse it
     std::ifstream fin(inputFilename.c_str());
     if (!fin) {
         cerr << "Error: unable to open " << inputFilename << " for reading." << endl;;
         return false;
     }
+    return readScene(fin);
+}
+
+bool Raytracer::readScene(std::istream& in)
+{
+    PhaseTimer timer(Stats::ParsePhase);
+
+    // Initialize a new scene, with the default options
+    delete scene;
+    delete camera;
+    camera = NULL;
+    scene = new Scene();
+    options = RenderOptions();
+
     try {
-        YAML::Parser parser(fin);
+        YAML::Parser parser(in);
         if (parser) {
             YAML::Node doc;
             parser.GetNextDocument(doc);
 
+            std::string mode;
             doc["RenderMode"] >> mode;
+            if(mode == "phong")         options.mode = RenderOptions::Phong;
+            else if(mode == "zbuffer")  options.mode = RenderOptions::ZBuffer;
+            else if(mode == "normal")   options.mode = RenderOptions::Normal;
+            else if(mode == "gooch")    options.mode = RenderOptions::Gooch;
+            else {
+                cerr << "Error: unknown render mode " << mode << "." << endl;
+                return false;
+            }
             if(mode == "gooch")
             {
                 const YAML::Node& gooch = doc["GoochParameters"];
-                gooch["b"] >> gp.b;
-                gooch["y"] >> gp.y;
-                gooch["alpha"] >> gp.alpha;
-                gooch["beta"] >> gp.beta;
+                gooch["b"] >> options.gp.b;
+                gooch["y"] >> options.gp.y;
+                gooch["alpha"] >> options.gp.alpha;
+                gooch["beta"] >> options.gp.beta;
+            }
+
+            doc["AA"] >> options.aaFactor;
+            // optional, only supersample the pixels that differ from their neighbours
+            if (doc.FindValue("AdaptiveAA") && doc["AdaptiveAA"] == "true") {
+                options.adaptive = true;
+            }
+            if (doc.FindValue("AAThreshold")) {
+                doc["AAThreshold"] >> options.aaThreshold;
+            }
+            // optional, coarse previews before the full render
+            if (doc.FindValue("Progressive") && doc["Progressive"] == "true") {
+                options.progressive = true;
+            }
+            if (doc.FindValue("Threads")) {
+                doc["Threads"] >> options.threads;
             }
+            if(doc["Shadows"] == "true")    options.shadows = true;
+            else                            options.shadows = false;
 
-            doc["AA"] >> aaFactor;
-            if(doc["Shadows"] == "true")    shadows = true;
-            else                            shadows = false;
+            if(doc["Reflections"] == "true")     options.reflection = true;
+            else                                options.reflection = false;
+            // optional, number of reflection bounces and the smallest
+            // contribution to the pixel worth tracing a reflection for
+            if (doc.FindValue("MaxDepth")) {
+                doc["MaxDepth"] >> options.maxDepth;
+            }
+            if (doc.FindValue("MinReflectionWeight")) {
+                doc["MinReflectionWeight"] >> options.minWeight;
+            }
 
-            if(doc["Reflections"] == "true")     reflections = true;
-            else                                reflections = false;
+            // optional, SIMD tracing of the camera rays
+            if(doc.FindValue("Packets") && doc["Packets"] == "true")
+            {
+                options.packets = true;
+            }
+            // optional, tile by tile tracing of ray streams instead of one
+            // pixel at a time
+            if(doc.FindValue("Wavefront") && doc["Wavefront"] == "true")
+            {
+                options.wavefront = true;
+            }
+            // optional, camera hits of a tile shaded sorted by material
+            if(doc.FindValue("Deferred") && doc["Deferred"] == "true")
+            {
+                options.deferred = true;
+            }
+
+            // optional, texture lookups: nearest (default), bilinear, or
+            // trilinear between mip levels chosen from the ray footprint
+            if(doc.FindValue("TextureFilter"))
+            {
+                std::string filter;
+                doc["TextureFilter"] >> filter;
+                if(filter == "nearest")         options.textureFilter = RenderOptions::Nearest;
+                else if(filter == "bilinear")   options.textureFilter = RenderOptions::Bilinear;
+                else if(filter == "trilinear")  options.textureFilter = RenderOptions::Trilinear;
+                else {
+                    cerr << "Error: unknown texture filter " << filter << "." << endl;
+                    return false;
+                }
+            }
+
+            // the buffer modes take one sample of the first hit
+            if(options.mode == RenderOptions::ZBuffer || options.mode == RenderOptions::Normal)
+            {
+                options.reflection = false;
+                options.aaFactor = 1;
+                options.adaptive = false;
+            }
 
             // Read scene configuration options
             const YAML::Node& cam = doc["Camera"];
@@ -219,6 +420,10 @@ bool Raytracer::readScene(const std::string& inputFilename)
                 return false;
             }
             for(YAML::Iterator it=sceneObjects.begin();it!=sceneObjects.end();++it) {
+                if ((*it)["type"] == "random") {
+                    parseRandomObjects(*it);
+                    continue;
+                }
                 Object *obj = parseObject(*it);
                 // Only add object if it is recognized
                 if (obj) {
@@ -235,8 +440,14 @@ bool Raytracer::readScene(const std::string& inputFilename)
                 return false;
             }
             for(YAML::Iterator it=sceneLights.begin();it!=sceneLights.end();++it) {
+                if ((*it).FindValue("count")) {
+                    parseRandomLights(*it);
+                    continue;
+                }
                 scene->addLight(parseLight(*it));
             }
+
+            scene->buildBVH();
         }
         if (parser) {
             cerr << "Warning: unexpected YAML document, ignored." << endl;
@@ -244,33 +455,99 @@ bool Raytracer::readScene(const std::string& inputFilename)
     } catch(YAML::ParserException& e) {
         std::cerr << "Error at line " << e.mark.line + 1 << ", col " << e.mark.column + 1 << ": " << e.msg << std::endl;
         return false;
+    } catch(std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
     }
 
     cout << "YAML parsing results: " << scene->getNumObjects() << " objects read." << endl;
     return true;
 }
 
-void Raytracer::renderToFile(const std::string& outputFilename)
+void Raytracer::prepare()
+{
+    scene->prepare(buffers, camera->xSize, camera->ySize, options);
+}
+
+bool Raytracer::render(Image &img, RenderObserver *observer)
 {
-    Image img(camera->xSize, camera->ySize);
     cout << "Tracing..." << endl;
-    if(mode == "phong")
+    return scene->render(img, camera, options, buffers, observer);
+}
+
+// Writes the passes of a progressive render to a preview file. The PNG is
+// encoded on a thread of its own while the render goes on, and a pass is
+// skipped while the previous preview is still being written, so the
+// render never waits for its previews.
+class PreviewWriter : public RenderObserver
+{
+public:
+    PreviewWriter(const std::string &path) : path(path), busy(false) { }
+    ~PreviewWriter() { finish(); }
+
+    bool frame(const Image &img, unsigned int pass, unsigned int passes)
     {
-    	scene->render(img, camera, shadows, reflections, 0, aaFactor, gp);
+        if (pass == passes || busy) return true;
+
+        finish();
+        if (preview.width() != img.width() || preview.height() != img.height()) {
+            preview.set_extent(img.width(), img.height());
+        }
+        for (int y = 0; y < img.height(); y++) {
+            for (int x = 0; x < img.width(); x++) {
+                preview(x, y) = img(x, y);
+            }
+        }
+        cout << "Writing preview " << pass << " of " << passes - 1 << " to " << path << endl;
+        busy = true;
+        writer = std::thread(&PreviewWriter::write, this);
+        return true;
     }
-    else if(mode == "zbuffer")
+
+    // waits for the preview being written
+    void finish()
     {
-    	scene->render(img, camera, shadows, false, 1, 1, gp);
+        if (writer.joinable()) writer.join();
     }
-    else if(mode == "normal")
+
+    // removes the preview file, also one left by an earlier render, once
+    // the final image is written
+    void remove()
     {
-    	scene->render(img, camera, shadows, false, 2, 1, gp);
+        finish();
+        std::remove(path.c_str());
     }
-    else if(mode == "gooch")
+
+private:
+    void write()
     {
-        scene->render(img, camera, shadows, reflections, 3, aaFactor, gp);
+        preview.write_png(path.c_str());
+        busy = false;
+    }
+
+    std::string path;
+    Image preview;              // copy of the pass being written
+    std::thread writer;
+    std::atomic<bool> busy;
+};
+
+void Raytracer::renderToFile(const std::string& outputFilename)
+{
+    // out.png gets its previews in out-preview.png
+    std::string previewFilename = outputFilename;
+    if (previewFilename.size() >= 4 && previewFilename.substr(previewFilename.size() - 4) == ".png") {
+        previewFilename = previewFilename.substr(0, previewFilename.size() - 4);
     }
+    previewFilename += "-preview.png";
+    PreviewWriter preview(previewFilename);
+
+    Image img(imageWidth(), imageHeight());
+    if (!render(img, &preview)) return;
     cout << "Writing image to " << outputFilename << "..." << endl;
-    img.write_png(outputFilename.c_str());
+    {
+        PhaseTimer timer(Stats::EncodePhase);
+        img.write_png(outputFilename.c_str());
+    }
+    preview.remove();
     cout << "Done." << endl;
 }
@@ -21,29 +21,44 @@
 #include "triple.h"
 #include "light.h"
 #include "camera.h"
-#include "goochparams.h"
 #include "scene.h"
+#include "generator.h"
 #include "yaml/yaml.h"
 
 class Raytracer {
 private:
     Scene *scene;
-    std::string mode;
-    bool shadows, reflections;
-    float aaFactor, angle;
+    RenderOptions options;
     Camera* camera;
-    GoochParams gp;
+    RenderBuffers buffers;
 
     // Couple of private functions for parsing YAML nodes
     Material* parseMaterial(const YAML::Node& node);
     Object* parseObject(const YAML::Node& node);
     Light* parseLight(const YAML::Node& node);
     Camera* parseCamera(const YAML::Node& node);
+    Distribution parseDistribution(const YAML::Node& node, Random& random);
+    void parseRandomObjects(const YAML::Node& node);
+    void parseRandomLights(const YAML::Node& node);
+
+    Raytracer(const Raytracer &);
+    Raytracer& operator=(const Raytracer &);
 
 public:
-    Raytracer() { }
+    Raytracer() : scene(NULL), camera(NULL) { }
+    ~Raytracer() { delete scene; delete camera; }
 
     bool readScene(const std::string& inputFilename);
+    bool readScene(std::istream& in);
+    void setThreads(unsigned int n) { options.threads = n; }
+    unsigned int imageWidth() const { return camera->xSize; }
+    unsigned int imageHeight() const { return camera->ySize; }
+    // allocates the buffers of the render ahead of it, render does it
+    // too when it wasn't called
+    void prepare();
+    // renders into an image of imageWidth() x imageHeight() pixels, false
+    // when the observer stopped a progressive render
+    bool render(Image &img, RenderObserver *observer = NULL);
     void renderToFile(const std::string& outputFilename);
 };
 
@@ -0,0 +1,54 @@
+//
+//  Framework for a raytracer
+//  File: renderoptions.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef RENDEROPTIONS_H
+#define RENDEROPTIONS_H
+
+#include "goochparams.h"
+
+// The settings of a render, read from the scene file. They are passed by
+// reference down to the shading of every hit.
+class RenderOptions
+{
+public:
+    enum Mode { Phong = 0, ZBuffer = 1, Normal = 2, Gooch = 3 };
+    enum TextureFilter { Nearest = 0, Bilinear = 1, Trilinear = 2 };
+
+    RenderOptions()
+        : mode(Phong), shadows(false), reflection(false), maxDepth(2), minWeight(1 / 512.0), aaFactor(1), threads(0),
+          packets(false), wavefront(false), deferred(false), adaptive(false), aaThreshold(0.05), progressive(false),
+          textureFilter(Nearest), coneSpread(0)
+    {
+        gp.b = gp.y = gp.alpha = gp.beta = 0;
+    }
+
+    unsigned int mode;
+    bool shadows, reflection;
+    unsigned int maxDepth;  // reflection bounces
+    float minWeight;        // reflections adding less than this to the pixel are not traced
+    GoochParams gp;
+    unsigned int aaFactor;  // aaFactor x aaFactor samples per pixel
+    unsigned int threads;   // 0 uses every core
+    bool packets;           // trace the camera rays of 2x2 pixels as one packet
+    bool wavefront;         // trace the rays of a tile stage by stage, see Wavefront
+    bool deferred;          // shade the camera hits of a tile by material, see GBuffer
+    bool adaptive;          // only supersample the pixels above aaThreshold
+    float aaThreshold;      // largest color difference with a neighbour left unrefined
+    bool progressive;       // coarse passes before the full render
+    unsigned int textureFilter;
+    float coneSpread;       // angle between neighbouring camera samples, set by Scene::render
+};
+
+#endif /* end of include guard: RENDEROPTIONS_H */
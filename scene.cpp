@@ -16,142 +16,344 @@
 //
 
 #include "scene.h"
+#include <algorithm>
+#include <thread>
 
-Color Scene::trace(const Ray &ray, unsigned int mode, bool shadows, bool reflection, unsigned int depth, unsigned int maxDepth, GoochParams gp)
+// BVH primitive tests over the bounded objects of a scene
+class ClosestObject
 {
-    // Find hit object and distance
-    Hit min_hit(std::numeric_limits<double>::infinity(),Vector());
-    Object *obj = NULL;
-    for (unsigned int i = 0; i < objects.size(); ++i) {
+public:
+    ClosestObject(const std::vector<Object*> &objects, const Ray &ray, Hit &min_hit)
+        : objects(objects), ray(ray), min_hit(min_hit), obj(NULL)
+    { }
+
+    bool operator()(unsigned int i, double &tMax)
+    {
+        Stats::count(objects[i]->tests);
         Hit hit(objects[i]->intersect(ray));
-        if (hit.t<min_hit.t) {
+        if (hit.t < min_hit.t) {
             min_hit = hit;
             obj = objects[i];
+            tMax = hit.t;
+            return true;
         }
+        return false;
     }
 
-    // No hit? Return background color.
-    if (!obj) return Color(0.0, 0.0, 0.0);
+    const std::vector<Object*> &objects;
+    const Ray &ray;
+    Hit &min_hit;
+    Object *obj;
+};
 
-    if(mode == 1) // zbuffer
+class BlockingObject
+{
+public:
+    BlockingObject(const std::vector<Object*> &objects, const Ray &ray, double tMax)
+        : objects(objects), ray(ray), tMax(tMax)
+    { }
+
+    bool operator()(unsigned int i)
     {
-        // simple normalization using min dist = 100, max dist = 10000
-        float dist = (10 - min_hit.t) / (1000 - 10);
-        return Vector(dist, dist, dist);
+        Stats::count(objects[i]->tests);
+        return objects[i]->occluded(ray, tMax);
     }
-    else if(mode == 2) // nbuffer
+
+    const std::vector<Object*> &objects;
+    const Ray &ray;
+    double tMax;
+};
+
+class PacketObjects
+{
+public:
+    PacketObjects(const std::vector<Object*> &objects, RayPacket &packet)
+        : objects(objects), packet(packet)
+    { }
+
+    void operator()(unsigned int i)
     {
-        // simple normalization again
-        return Vector((min_hit.N.x+1)/2, (min_hit.N.y+1)/2, (min_hit.N.z+1)/2);
+        Stats::count(objects[i]->tests, RayPacket::size);
+        objects[i]->intersectPacket(packet);
     }
 
-    if(reflection && (depth < maxDepth))
-    {
-        Vector reflDir = ray.D - 2 * (ray.D.dot(min_hit.N) * min_hit.N);
-        Ray reflectRay(ray.at(min_hit.t) + reflDir * 0.1, reflDir);
-        
-        Color reflCol = trace(reflectRay, mode, shadows, reflection, depth + 1, maxDepth, gp);
+    const std::vector<Object*> &objects;
+    RayPacket &packet;
+};
 
-        Color normalCol = totalColor(ray, min_hit, lights, obj->angle, obj->material, shadows, false, mode, gp);
-        return normalCol + reflCol * obj->material->ks;
+Object* Scene::closestHit(const Ray &ray, Hit &min_hit)
+{
+    Object *obj = NULL;
+    for (unsigned int i = 0; i < unbounded.size(); ++i) {
+        Stats::count(unbounded[i]->tests);
+        Hit hit(unbounded[i]->intersect(ray));
+        if (hit.t<min_hit.t) {
+            min_hit = hit;
+            obj = unbounded[i];
+        }
     }
-    else
-    {
-        return totalColor(ray, min_hit, lights, obj->angle, obj->material, shadows, reflection, mode, gp);
+
+    double tMax = min_hit.t;
+    ClosestObject closest(bounded, ray, min_hit);
+    if (bvh.intersect(ray, tMax, closest)) {
+        obj = closest.obj;
     }
+    return obj;
+}
+
+// Is anything in the way between the ray origin and the distance tMax?
+bool Scene::occluded(const Ray &ray, double tMax)
+{
+    for (unsigned int i = 0; i < unbounded.size(); ++i) {
+        Stats::count(unbounded[i]->tests);
+        if (unbounded[i]->occluded(ray, tMax)) return true;
+    }
+
+    BlockingObject blocking(bounded, ray, tMax);
+    return bvh.any(ray, tMax, blocking);
+}
+
+// Every render thread traces its reflections with its own stack
+static thread_local RayStack rayStack;
 
+Color Scene::trace(const Ray &ray, const RenderOptions &options)
+{
+    rayStack.push(ray, 1, 0, 0);
+    return traceStack(rayStack, options);
 }
 
-Color Scene::totalColor(const Ray &ray, Hit min_hit, std::vector<Light*> lights, float angle, Material *material, bool shadows, bool reflection, unsigned int mode, GoochParams gp)
+// Traces the rays of the stack until it is empty, adding up their
+// weighted colors. The reflections pushed while shading are traced in the
+// same loop, so deep reflections don't grow the call stack.
+Color Scene::traceStack(RayStack &stack, const RenderOptions &options)
 {
+    Color color(0.0, 0.0, 0.0);
+    while (!stack.empty()) {
+        RayStack::Entry entry = stack.pop();
 
-    Point hit = ray.at(min_hit.t);                 //the hit point
-    Vector N = min_hit.N;                          //the normal at hit point
-    Vector V = -ray.D;                             //the view vector
+        // Find hit object and distance
+        Hit min_hit(std::numeric_limits<double>::infinity());
+        Object *obj = closestHit(entry.ray, min_hit);
 
-    Vector intensity = Vector(0 , 0 , 0);
+        // No hit? Background color.
+        if (!obj) continue;
 
-    if(mode == 3 && N.dot(V) < 0.2)
+        Vector N = obj->normal(entry.ray, min_hit);
+        color += shade(entry.ray, min_hit, N, obj, options, entry.weight, entry.depth, entry.dist, stack) * entry.weight;
+    }
+    return color;
+}
+
+// Pushes the reflection of a hit, with depth the number of bounces,
+// weight the contribution of the ray to the pixel and dist the distance it
+// travelled before its origin. Reflections adding less than
+// options.minWeight to the pixel are dropped, so diffuse surfaces (ks = 0)
+// and the last faint bounces cost nothing.
+void Scene::reflect(const Ray &ray, const Hit &hit, const Vector &N, const Object *obj, const RenderOptions &options, float weight, unsigned int depth, float dist, RayStack &stack)
+{
+    float reflWeight = weight * obj->material->ks;
+    if(options.reflection && (depth < options.maxDepth) && reflWeight > 0 && reflWeight >= options.minWeight)
     {
-        return Color(0.0, 0.0, 0.0);
+        Vector reflDir = ray.D - 2 * (ray.D.dot(N) * N);
+        Ray reflectRay(ray.at(hit.t) + reflDir * 0.1, reflDir);
+        if (stack.push(reflectRay, reflWeight, depth + 1, dist + hit.t)) Stats::count(Stats::ReflectionRays);
     }
+}
 
-    for (std::vector<Light*>::iterator it = lights.begin() ; it != lights.end(); ++it)
+// Local color of a hit with normal N, its reflection is pushed on the stack
+Color Scene::shade(const Ray &ray, const Hit &min_hit, const Vector &N, const Object *obj, const RenderOptions &options, float weight, unsigned int depth, float dist, RayStack &stack)
+{
+    if(options.mode == RenderOptions::ZBuffer)
+    {
+        // simple normalization using min dist = 100, max dist = 10000
+        float dist = (10 - min_hit.t) / (1000 - 10);
+        return Vector(dist, dist, dist);
+    }
+    else if(options.mode == RenderOptions::Normal)
     {
-        Light* light = *it;
+        // simple normalization again
+        return Vector((N.x+1)/2, (N.y+1)/2, (N.z+1)/2);
+    }
 
-        Triple lightIntensity;
+    reflect(ray, min_hit, N, obj, options, weight, depth, dist, stack);
+    float lod = textureLevel(ray, min_hit, N, *obj, options, dist);
+    return totalColor(ShadingContext(ray, min_hit, N, *obj, options, lod));
+}
 
-        float difftIntensity, specIntensity;
-        phong(hit, light->position, N, V, material, difftIntensity, specIntensity);
+// Traces the primary rays of a packet. The closest objects are found for the
+// whole packet with the SIMD kernels, the hits are then recomputed and shaded
+// one ray at a time, so reflection and shadow rays are traced on their own.
+void Scene::tracePacket(RayPacket &packet, Color *colors, const RenderOptions &options)
+{
+    for (unsigned int i = 0; i < unbounded.size(); ++i) {
+        Stats::count(unbounded[i]->tests, RayPacket::size);
+        unbounded[i]->intersectPacket(packet);
+    }
+    PacketObjects isect(bounded, packet);
+    bvh.intersect(packet, isect);
 
-        if(mode == 0) // phong
-        {
-            lightIntensity = light->color * (difftIntensity + specIntensity);
+    for (unsigned int i = 0; i < RayPacket::size; i++) {
+        if (!packet.rays[i]) continue;
+        const Ray &ray = *packet.rays[i];
+        Object *obj = packet.obj[i];
+
+        if (!obj) {
+            colors[i] = Color(0.0, 0.0, 0.0);
+            continue;
         }
-        if(mode == 3) // gooch
-        {
-            Vector L = light->position - hit;
-            L = L.normalized();
-            Triple kd = light->color * material->color * material->kd;
 
-            Triple kBlue = Triple(0, 0, gp.b);
-            Triple kYellow = Triple(gp.y, gp.y, 0);
+        Stats::count(obj->tests);
+        Hit hit(obj->intersect(ray));
+        if (hit.no_hit) {
+            // single precision disagreed on a grazing hit
+            colors[i] = trace(ray, options);
+        } else {
+            colors[i] = shade(ray, hit, obj->normal(ray, hit), obj, options, 1, 0, 0, rayStack);
+            colors[i] += traceStack(rayStack, options);
+        }
+    }
+}
 
-            Triple kCool = kBlue + gp.alpha * kd;
-            Triple kWarm = kYellow + gp.beta * kd;
+// Adds up the lights with a radius reaching a hit point
+class Scene::LightVisitor
+{
+public:
+    LightVisitor(Scene &scene, const ShadingContext &context, Vector &intensity)
+        : scene(scene), context(context), intensity(intensity)
+    { }
 
-            lightIntensity = kCool * (1 - N.dot(L)) / 2.0 + kWarm * (1 + N.dot(L)) / 2.0;
-            lightIntensity += specIntensity;
-        }
-        
+    void operator()(unsigned int i)
+    {
+        intensity += scene.lightIntensity(*scene.localLights[i], context);
+    }
 
-        if(shadows)
-        {
-            bool shadowed = false;
-            unsigned int i = 0;
-            Vector dir = (light->position - hit).normalized();
-            Ray lightRay(hit + dir * 0.1, dir);
-            while (!shadowed && i < objects.size()) 
-            {
-                Hit hit(objects[i]->intersect(lightRay));
-                if (hit.no_hit == false) 
-                {
-                    shadowed = true;
-                }
-                i++;
-            }
-            if(shadowed == true)
-            {
-                lightIntensity *= 0.2;
-            }
-        }
+    Scene &scene;
+    const ShadingContext &context;
+    Vector &intensity;
+};
+
+Color Scene::totalColor(const ShadingContext &context)
+{
+    return albedo(context) * lightSum(context);
+}
+
+// Light reaching a hit from every light, before the albedo. Gooch shading
+// draws the silhouettes black.
+Triple Scene::lightSum(const ShadingContext &context)
+{
+    Vector intensity = Vector(0 , 0 , 0);
 
-        intensity += lightIntensity;
+    if(context.options.mode == RenderOptions::Gooch && context.N.dot(context.V) < 0.2)
+    {
+        return intensity;
+    }
+
+    for (unsigned int i = 0; i < globalLights.size(); i++)
+    {
+        intensity += lightIntensity(*globalLights[i], context);
     }
-    
-    Color color;
+    LightVisitor visitor(*this, context, intensity);
+    lightBVH.containing(Vec3(context.point), visitor);
 
+    return intensity;
+}
+
+// What the light reaching a hit is multiplied by: the texture or the
+// material color in phong mode, white in gooch mode
+Color Scene::albedo(const ShadingContext &context)
+{
+    const Material *material = context.material;
     if(material->texture != NULL)
     {
-        Image* tex = material->texture;
-        color = getTexColor(tex, N, angle) * intensity;
+        return getTexColor(context);
     }
-    else if(mode == 0)
+    else if(context.options.mode == RenderOptions::Phong)
     {
-        color = material->color * intensity;
+        return material->color;
     }
-    else if(mode == 3)
+    return Color(1.0, 1.0, 1.0);
+}
+
+// Unshadowed contribution of one light at a hit point, false when the
+// light adds nothing. Lights out of reach and, in phong mode, lights
+// behind the surface are skipped before their shadow ray. Gooch shading
+// uses the lights behind too.
+bool Scene::lightContribution(const Light &light, const ShadingContext &context, Triple &intensity, double &attenuation)
+{
+    const Point &hit = context.point;
+    const Vector &N = context.N;
+    const Material *material = context.material;
+    const GoochParams &gp = context.options.gp;
+    unsigned int mode = context.options.mode;
+
+    Vector toLight = light.position - hit;
+    attenuation = light.attenuation(toLight.length());
+    if (attenuation <= 0) return false;
+    if (mode == RenderOptions::Phong && N.dot(toLight) <= 0) return false;
+
+    Triple lightIntensity;
+
+    float difftIntensity, specIntensity;
+    phong(hit, light.position, N, context.V, material, difftIntensity, specIntensity);
+
+    if(mode == RenderOptions::Phong)
     {
-        color = intensity;
+        lightIntensity = light.color * (difftIntensity + specIntensity);
     }
+    if(mode == RenderOptions::Gooch)
+    {
+        Vector L = light.position - hit;
+        L = L.normalized();
+        Triple kd = light.color * material->color * material->kd;
 
-    return color;
+        Triple kBlue = Triple(0, 0, gp.b);
+        Triple kYellow = Triple(gp.y, gp.y, 0);
+
+        Triple kCool = kBlue + gp.alpha * kd;
+        Triple kWarm = kYellow + gp.beta * kd;
+
+        lightIntensity = kCool * (1 - N.dot(L)) / 2.0 + kWarm * (1 + N.dot(L)) / 2.0;
+        lightIntensity += specIntensity;
+    }
+
+    intensity = lightIntensity;
+    return true;
+}
+
+// Ray from a hit point towards a light. Only the objects closer than
+// tMax, between the point and the light, cast a shadow.
+static Ray shadowRay(const Point &hit, const Point &lightPosition, double &tMax)
+{
+    Vector dir = (lightPosition - hit).normalized();
+    Ray ray(hit + dir * 0.1, dir);
+    tMax = (lightPosition - ray.O).length();
+    return ray;
+}
+
+// Contribution of one light at a hit point, darkened in the shadow
+Triple Scene::lightIntensity(const Light &light, const ShadingContext &context)
+{
+    Triple intensity;
+    double attenuation;
+    if (!lightContribution(light, context, intensity, attenuation)) return Triple(0, 0, 0);
+
+    if(context.options.shadows)
+    {
+        double tMax;
+        Ray lightRay = shadowRay(context.point, light.position, tMax);
+        Stats::count(Stats::ShadowRays);
+        if(occluded(lightRay, tMax))
+        {
+            intensity *= 0.2;
+        }
+    }
+
+    return intensity * attenuation;
 }
 
 // phong
 // https://en.wikipedia.org/wiki/Phong_reflection_model
-void Scene::phong(Point hit, Point lightPosition, Vector N, Vector V, Material *mat, float &difftIntensity, float &specIntensity)
+void Scene::phong(const Point &hit, const Point &lightPosition, const Vector &N, const Vector &V, const Material *mat, float &difftIntensity, float &specIntensity)
 {
     Vector lm = lightPosition - hit;
     lm = lm.normalized();
@@ -171,56 +373,687 @@ void Scene::phong(Point hit, Point lightPosition, Vector N, Vector V, Material *
     if(specIntensity < 0)  specIntensity = 0;
 }
 
-void Scene::render(Image &img, Camera *cam, bool shadows, bool reflection, unsigned int renderType, unsigned int aaFactor, GoochParams gp)
+// Renders the image in tiles of RenderJob::tileSize pixels. The workers grab
+// the next tile from a shared counter, so tiles that are expensive to trace
+// don't leave the other threads waiting. Every pixel is computed the same way
+// whatever the number of threads, so the output doesn't depend on it.
+// Returns false when the observer stopped a progressive render.
+bool Scene::render(Image &img, Camera *cam, const RenderOptions &options, RenderBuffers &buffers, RenderObserver *observer)
 {
-    std::clock_t tInit = std::clock();
-    std::cout << "Rendering begins." << std::endl;
+    PhaseTimer timer(Stats::RenderPhase);
+
+    unsigned int threads = renderThreads(options);
+    bool progressive = options.progressive;
+    prepare(buffers, img.width(), img.height(), options);
+    std::cout << "Rendering begins (" << threads << " threads)." << std::endl;
+
+    RenderJob job;
+    job.img = &img;
+    job.cam = cam;
+    job.options = options;
+    job.options.adaptive = options.adaptive && options.aaFactor > 1;
+    job.firstSamples = NULL;
+    job.buffers = &buffers;
 
     int w = img.width();
     int h = img.height();
-    float pixSize = cam->up.length();
+    job.pixSize = cam->up.length();
     Vector lookDir = cam->center - cam->eye;
-    Vector xDir = lookDir.cross(cam->up);
-    Vector yDir = xDir.cross(lookDir);
-    xDir = xDir.normalized();
-    yDir = yDir.normalized();
-    Vector start = cam->center - (pixSize * w / 2.0) * xDir - (pixSize * h / 2.0) * yDir;
-    for (int y = 0; y < h; y++) {
-        for (int x = 0; x < w; x++) {
+    job.xDir = lookDir.cross(cam->up);
+    job.yDir = job.xDir.cross(lookDir);
+    job.xDir = job.xDir.normalized();
+    job.yDir = job.yDir.normalized();
+    job.start = cam->center - (job.pixSize * w / 2.0) * job.xDir - (job.pixSize * h / 2.0) * job.yDir;
+    job.options.coneSpread = job.pixSize / lookDir.length() / job.options.aaFactor;
+
+    job.tilesX = (w + RenderJob::tileSize - 1) / RenderJob::tileSize;
+    job.tilesY = (h + RenderJob::tileSize - 1) / RenderJob::tileSize;
+
+    // coarse passes of 8x8, 4x4 and 2x2 pixel blocks, then the full render
+    unsigned int passes = 1;
+    if (progressive) {
+        for (int size = RenderJob::coarseSize; size > 1; size /= 2) passes++;
+    }
+    unsigned int pass = 1;
+    for (job.blockSize = RenderJob::coarseSize; progressive && job.blockSize > 1; job.blockSize /= 2, pass++) {
+        job.pass = RenderJob::Coarse;
+        runWorkers(job, threads);
+        if (observer && !observer->frame(img, pass, passes)) {
+            std::cout << "Rendering stopped after pass " << pass << " of " << passes << "." << std::endl;
+            return false;
+        }
+    }
+
+    if (job.options.adaptive) {
+        // the refinement looks at the first samples of the neighbours, so
+        // they all have to be known before it starts
+        job.firstSamples = &buffers.firstSamples;
+        job.pass = RenderJob::FirstSamples;
+        runWorkers(job, threads);
+        job.pass = RenderJob::Refine;
+        runWorkers(job, threads);
+    } else {
+        job.pass = RenderJob::AllSamples;
+        runWorkers(job, threads);
+    }
+
+    std::cout << "Rendering ended: " << timer.elapsed() << " seconds" << std::endl;
+    if (observer && progressive) observer->frame(img, passes, passes);
+    return true;
+}
+
+unsigned int Scene::renderThreads(const RenderOptions &options)
+{
+    unsigned int threads = options.threads;
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    return threads;
+}
+
+void Scene::prepare(RenderBuffers &buffers, int w, int h, const RenderOptions &options)
+{
+    unsigned int threads = renderThreads(options);
+    unsigned int rays = RenderJob::tileSize * RenderJob::tileSize * options.aaFactor * options.aaFactor;
+
+    if (options.wavefront) {
+        if (buffers.wavefronts.size() < threads) buffers.wavefronts.resize(threads);
+        for (unsigned int i = 0; i < threads; i++) {
+            buffers.wavefronts[i].reserve(rays);
+        }
+    }
+    if (options.deferred) {
+        if (buffers.gbuffers.size() < threads) buffers.gbuffers.resize(threads);
+        for (unsigned int i = 0; i < threads; i++) {
+            buffers.gbuffers[i].reserve(rays);
+        }
+    }
+    if (options.adaptive && options.aaFactor > 1) {
+        Image &firstSamples = buffers.firstSamples;
+        if (firstSamples.width() != w || firstSamples.height() != h) firstSamples.set_extent(w, h);
+    }
+}
+
+void Scene::runWorkers(RenderJob &job, unsigned int threads)
+{
+    job.nextTile = 0;
+    if (threads == 1) {
+        renderTiles(job, 0);
+    } else {
+        std::vector<std::thread> workers;
+        for (unsigned int i = 0; i < threads; i++) {
+            workers.push_back(std::thread(&Scene::renderTiles, this, std::ref(job), i));
+        }
+        for (unsigned int i = 0; i < workers.size(); i++) {
+            workers[i].join();
+        }
+    }
+}
+
+void Scene::renderTiles(RenderJob &job, unsigned int worker)
+{
+    int w = job.img->width();
+    int h = job.img->height();
+    int numTiles = job.tilesX * job.tilesY;
+    // sample of the first pass, the one closest to the pixel center
+    unsigned int first = (job.options.aaFactor + 1) / 2;
+
+    for (int tile = job.nextTile++; tile < numTiles; tile = job.nextTile++) {
+        int x0 = (tile % job.tilesX) * RenderJob::tileSize;
+        int y0 = (tile / job.tilesX) * RenderJob::tileSize;
+        int x1 = std::min(x0 + RenderJob::tileSize, w);
+        int y1 = std::min(y0 + RenderJob::tileSize, h);
+
+        if (job.pass == RenderJob::Coarse) {
+            renderCoarse(job, x0, y0, x1, y1);
+        } else if (job.pass == RenderJob::FirstSamples && job.options.packets) {
+            for (int y = y0; y < y1; y += 2) {
+                for (int x = x0; x < x1; x += 2) {
+                    Color colors[RayPacket::size];
+                    sampleBlock(job, x, y, first, first, colors);
+                    for (int k = 0; k < 4; k++) {
+                        if (x + k % 2 < w && y + k / 2 < h) (*job.firstSamples)(x + k % 2, y + k / 2) = colors[k];
+                    }
+                }
+            }
+        } else if (job.pass == RenderJob::FirstSamples) {
+            for (int y = y0; y < y1; y++) {
+                for (int x = x0; x < x1; x++) {
+                    (*job.firstSamples)(x,y) = sample(job, x, y, first, first);
+                }
+            }
+        } else if (job.pass == RenderJob::Refine) {
+            for (int y = y0; y < y1; y++) {
+                for (int x = x0; x < x1; x++) {
+                    (*job.img)(x,y) = refinePixel(job, x, y);
+                }
+            }
+        } else if (job.options.wavefront) {
+            renderWavefront(job, x0, y0, x1, y1, job.buffers->wavefronts[worker]);
+        } else if (job.options.deferred) {
+            renderDeferred(job, x0, y0, x1, y1, job.buffers->gbuffers[worker]);
+        } else if (job.options.packets) {
+            for (int y = y0; y < y1; y += 2) {
+                for (int x = x0; x < x1; x += 2) {
+                    renderBlock(job, x, y);
+                }
+            }
+        } else {
+            for (int y = y0; y < y1; y++) {
+                for (int x = x0; x < x1; x++) {
+                    (*job.img)(x,y) = renderPixel(job, x, y);
+                }
+            }
+        }
+    }
+    Stats::flush();
+}
+
+// Camera ray through the AA sample (i, j) of pixel (x, y), i and j go from 1 to aaFactor
+Ray Scene::primaryRay(const RenderJob &job, int x, int y, unsigned int i, unsigned int j)
+{
+    const Vector &xDir = job.xDir;
+    const Vector &yDir = job.yDir;
+    unsigned int aaFactor = job.options.aaFactor;
+    int h = job.img->height();
+
+    float aaX = i * (xDir.x + yDir.x) / (float) (aaFactor + 1.0);
+    float aaY = j * (xDir.y + yDir.y) / (float) (aaFactor + 1.0);
+    Point pixel = job.start + job.pixSize * ((x + aaX) * xDir + (h - y + aaY) * yDir);
+    return Ray(job.cam->eye, (pixel-job.cam->eye).normalized());
+}
+
+// Clamped color of the AA sample (i, j) of pixel (x, y)
+Color Scene::sample(const RenderJob &job, int x, int y, unsigned int i, unsigned int j)
+{
+    Ray ray = primaryRay(job, x, y, i, j);
+    Stats::count(Stats::PrimaryRays);
+    Color col = trace(ray, job.options);
+    col.clamp();
+    return col;
+}
+
+Color Scene::renderPixel(const RenderJob &job, int x, int y)
+{
+    unsigned int aaFactor = job.options.aaFactor;
+
+    Color totalCol(0.0, 0.0, 0.0);
+    for(unsigned int i = 1; i < (aaFactor + 1); i++)
+    {
+        for(unsigned int j = 1; j < (aaFactor + 1); j++)
+        {
+            totalCol += sample(job, x, y, i, j);
+        }
+    }
+    return totalCol / (float) (aaFactor * aaFactor);
+}
+
+// Traces the same AA sample of the 2x2 pixels starting at (x, y) as one
+// packet. Lanes outside of the image stay inactive.
+void Scene::sampleBlock(const RenderJob &job, int x, int y, unsigned int i, unsigned int j, Color *colors)
+{
+    int w = job.img->width();
+    int h = job.img->height();
+    int px[RayPacket::size] = { x, x + 1, x, x + 1 };
+    int py[RayPacket::size] = { y, y, y + 1, y + 1 };
+
+    Ray rays[RayPacket::size] = {
+        primaryRay(job, px[0], py[0], i, j), primaryRay(job, px[1], py[1], i, j),
+        primaryRay(job, px[2], py[2], i, j), primaryRay(job, px[3], py[3], i, j)
+    };
+    RayPacket packet;
+    for (unsigned int k = 0; k < RayPacket::size; k++) {
+        if (px[k] < w && py[k] < h) {
+            packet.set(k, rays[k]);
+            Stats::count(Stats::PrimaryRays);
+        }
+    }
+
+    tracePacket(packet, colors, job.options);
+    for (unsigned int k = 0; k < RayPacket::size; k++) {
+        colors[k].clamp();
+    }
+}
+
+// Renders the 2x2 pixels starting at (x, y), tracing the same AA sample of
+// the four pixels as one packet.
+void Scene::renderBlock(const RenderJob &job, int x, int y)
+{
+    unsigned int aaFactor = job.options.aaFactor;
+    int w = job.img->width();
+    int h = job.img->height();
+    int px[RayPacket::size] = { x, x + 1, x, x + 1 };
+    int py[RayPacket::size] = { y, y, y + 1, y + 1 };
+
+    Color totalCol[RayPacket::size];
+    for(unsigned int i = 1; i < (aaFactor + 1); i++)
+    {
+        for(unsigned int j = 1; j < (aaFactor + 1); j++)
+        {
+            Color colors[RayPacket::size];
+            sampleBlock(job, x, y, i, j, colors);
+            for (unsigned int k = 0; k < RayPacket::size; k++) {
+                totalCol[k] += colors[k];
+            }
+        }
+    }
+
+    for (unsigned int k = 0; k < RayPacket::size; k++) {
+        if (px[k] < w && py[k] < h) (*job.img)(px[k],py[k]) = totalCol[k] / (float) (aaFactor * aaFactor);
+    }
+}
+
+// Coarse pass over a tile: one sample for the top left pixel of every
+// block, filling the whole block. The pixels already sampled by the
+// previous pass, with blocks twice as large, are only refilled.
+void Scene::renderCoarse(const RenderJob &job, int x0, int y0, int x1, int y1)
+{
+    int size = job.blockSize;
+    unsigned int first = (job.options.aaFactor + 1) / 2;
+
+    for (int y = y0; y < y1; y += size) {
+        for (int x = x0; x < x1; x += size) {
+            bool sampled = size < RenderJob::coarseSize && x % (2 * size) == 0 && y % (2 * size) == 0;
+            Color col = sampled ? (*job.img)(x,y) : sample(job, x, y, first, first);
+            for (int by = y; by < std::min(y + size, y1); by++) {
+                for (int bx = x; bx < std::min(x + size, x1); bx++) {
+                    (*job.img)(bx,by) = col;
+                }
+            }
+        }
+    }
+}
+
+// Second pass of adaptive antialiasing. A pixel whose first sample is
+// within aaThreshold of the first samples of its eight neighbours keeps
+// it, the others get every sample like renderPixel. Details smaller than
+// a pixel that the first samples all miss are not refined.
+Color Scene::refinePixel(const RenderJob &job, int x, int y)
+{
+    const Image &firstSamples = *job.firstSamples;
+    const Color &c = firstSamples(x, y);
+    int w = firstSamples.width();
+    int h = firstSamples.height();
+
+    bool flat = true;
+    for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, h - 1) && flat; ny++) {
+        for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, w - 1) && flat; nx++) {
+            const Color &n = firstSamples(nx, ny);
+            flat = fabs(n.r - c.r) <= job.options.aaThreshold && fabs(n.g - c.g) <= job.options.aaThreshold && fabs(n.b - c.b) <= job.options.aaThreshold;
+        }
+    }
+    if (flat) return c;
+
+    unsigned int aaFactor = job.options.aaFactor;
+    unsigned int first = (aaFactor + 1) / 2;
+    Color totalCol(0.0, 0.0, 0.0);
+    for(unsigned int i = 1; i < (aaFactor + 1); i++)
+    {
+        for(unsigned int j = 1; j < (aaFactor + 1); j++)
+        {
+            totalCol += (i == first && j == first) ? c : sample(job, x, y, i, j);
+        }
+    }
+    return totalCol / (float) (aaFactor * aaFactor);
+}
+
+// Orders the hits of a wavefront or a G-buffer by material, so the
+// shading of one material is done in one go. Hits of the same material
+// keep the order of their rays.
+class ByMaterial
+{
+public:
+    bool operator()(const Wavefront::PathHit &a, const Wavefront::PathHit &b) const
+    {
+        if (a.obj->material != b.obj->material) return a.obj->material < b.obj->material;
+        return a.ray < b.ray;
+    }
+
+    bool operator()(const GBuffer::Sample &a, const GBuffer::Sample &b) const
+    {
+        if (a.obj->material != b.obj->material) return a.obj->material < b.obj->material;
+        return a.sample < b.sample;
+    }
+};
+
+// Renders a tile as one stream of rays, every AA sample of every pixel at
+// once. Each stage intersects all of its rays, sorts the hits by material
+// and shades them, which gives the shadow rays, traced next, and the
+// reflections, which are the rays of the next stage.
+void Scene::renderWavefront(const RenderJob &job, int x0, int y0, int x1, int y1, Wavefront &wavefront)
+{
+    unsigned int aaFactor = job.options.aaFactor;
+    unsigned int perPixel = aaFactor * aaFactor;
+    int width = x1 - x0;
+
+    wavefront.rays.clear();
+    wavefront.samples.assign(width * (y1 - y0) * perPixel, Color(0.0, 0.0, 0.0));
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            unsigned int pixel = ((y - y0) * width + (x - x0)) * perPixel;
+            for(unsigned int i = 1; i < (aaFactor + 1); i++) {
+                for(unsigned int j = 1; j < (aaFactor + 1); j++) {
+                    unsigned int sample = pixel + (i - 1) * aaFactor + (j - 1);
+                    wavefront.rays.push_back(Wavefront::PathRay(primaryRay(job, x, y, i, j), 1, 0, 0, sample));
+                }
+            }
+        }
+    }
+    Stats::count(Stats::PrimaryRays, wavefront.rays.size());
+
+    while (!wavefront.rays.empty()) {
+        wavefront.hits.clear();
+        for (unsigned int k = 0; k < wavefront.rays.size(); k++) {
+            Hit min_hit(std::numeric_limits<double>::infinity());
+            Object *obj = closestHit(wavefront.rays[k].ray, min_hit);
+            if (obj) wavefront.hits.push_back(Wavefront::PathHit(min_hit, obj, k));
+        }
+        std::sort(wavefront.hits.begin(), wavefront.hits.end(), ByMaterial());
+
+        wavefront.reflections.clear();
+        wavefront.shadows.clear();
+        for (unsigned int k = 0; k < wavefront.hits.size(); k++) {
+            shadeWavefront(wavefront.hits[k], job.options, wavefront);
+        }
+        traceShadows(wavefront);
+
+        wavefront.rays.swap(wavefront.reflections);
+    }
+
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            unsigned int pixel = ((y - y0) * width + (x - x0)) * perPixel;
             Color totalCol(0.0, 0.0, 0.0);
-            for(unsigned int i = 1; i < (aaFactor + 1); i++)
-            {
-                for(unsigned int j = 1; j < (aaFactor + 1); j++)
-                {
-                    float aaX = i * (xDir.x + yDir.x) / (float) (aaFactor + 1.0);
-                    float aaY = j * (xDir.y + yDir.y) / (float) (aaFactor + 1.0);
-                    Point pixel = start + pixSize * ((x + aaX) * xDir + (h - y + aaY) * yDir);
-                    Ray ray(cam->eye, (pixel-cam->eye).normalized());
-                    Color col = trace(ray, renderType, shadows, reflection, 0, 2, gp);
-                    col.clamp();
-                    totalCol += col;
+            for (unsigned int k = 0; k < perPixel; k++) {
+                Color col = wavefront.samples[pixel + k];
+                col.clamp();
+                totalCol += col;
+            }
+            (*job.img)(x,y) = totalCol / (float) perPixel;
+        }
+    }
+}
+
+// Traces the queued shadow rays of a wavefront, adding the colors of the
+// lights they reach to their samples
+void Scene::traceShadows(Wavefront &wavefront)
+{
+    Stats::count(Stats::ShadowRays, wavefront.shadows.size());
+    for (unsigned int k = 0; k < wavefront.shadows.size(); k++) {
+        const Wavefront::ShadowRay &shadow = wavefront.shadows[k];
+        if (occluded(shadow.ray, shadow.tMax)) {
+            wavefront.samples[shadow.sample] += shadow.color * 0.2;
+        } else {
+            wavefront.samples[shadow.sample] += shadow.color;
+        }
+    }
+    wavefront.shadows.clear();
+}
+
+// Adds the lights of a hit to its sample in wavefront mode, or queues them
+// for their shadow ray, tracing the queue first when it is full
+class Scene::LightEmitter
+{
+public:
+    LightEmitter(Scene &scene, const ShadingContext &context, const Color &color, unsigned int sample, Wavefront &wavefront)
+        : scene(scene), context(context), color(color), sample(sample), wavefront(wavefront)
+    { }
+
+    void operator()(unsigned int i)
+    {
+        emit(*scene.localLights[i]);
+    }
+
+    void emit(const Light &light)
+    {
+        Triple intensity;
+        double attenuation;
+        if (!scene.lightContribution(light, context, intensity, attenuation)) return;
+
+        Color lightColor = color * intensity * attenuation;
+        if (!context.options.shadows) {
+            wavefront.samples[sample] += lightColor;
+            return;
+        }
+        double tMax;
+        Ray ray = shadowRay(context.point, light.position, tMax);
+        if (wavefront.shadows.size() == Wavefront::maxShadows) scene.traceShadows(wavefront);
+        wavefront.shadows.push_back(Wavefront::ShadowRay(ray, tMax, lightColor, sample));
+    }
+
+    Scene &scene;
+    const ShadingContext &context;
+    Color color;            // albedo times the weight of the ray
+    unsigned int sample;
+    Wavefront &wavefront;
+};
+
+// Shades a hit of a wavefront like shade, queueing its reflection and
+// shadow rays instead of tracing them
+void Scene::shadeWavefront(const Wavefront::PathHit &pathHit, const RenderOptions &options, Wavefront &wavefront)
+{
+    const Wavefront::PathRay &pathRay = wavefront.rays[pathHit.ray];
+    const Hit &hit = pathHit.hit;
+    const Object *obj = pathHit.obj;
+    Color &sample = wavefront.samples[pathRay.sample];
+    Vector N = obj->normal(pathRay.ray, hit);
+
+    if(options.mode == RenderOptions::ZBuffer || options.mode == RenderOptions::Normal)
+    {
+        RayStack unused;
+        sample += shade(pathRay.ray, hit, N, obj, options, pathRay.weight, pathRay.depth, pathRay.dist, unused);
+        return;
+    }
+
+    float reflWeight = pathRay.weight * obj->material->ks;
+    if(options.reflection && (pathRay.depth < options.maxDepth) && reflWeight > 0 && reflWeight >= options.minWeight)
+    {
+        Vector reflDir = pathRay.ray.D - 2 * (pathRay.ray.D.dot(N) * N);
+        Ray reflectRay(pathRay.ray.at(hit.t) + reflDir * 0.1, reflDir);
+        Stats::count(Stats::ReflectionRays);
+        wavefront.reflections.push_back(Wavefront::PathRay(reflectRay, reflWeight, pathRay.depth + 1, pathRay.dist + hit.t, pathRay.sample));
+    }
+
+    float lod = textureLevel(pathRay.ray, hit, N, *obj, options, pathRay.dist);
+    ShadingContext context(pathRay.ray, hit, N, *obj, options, lod);
+    if(options.mode == RenderOptions::Gooch && context.N.dot(context.V) < 0.2)
+    {
+        return;
+    }
+
+    LightEmitter emitter(*this, context, albedo(context) * pathRay.weight, pathRay.sample, wavefront);
+    for (unsigned int i = 0; i < globalLights.size(); i++)
+    {
+        emitter.emit(*globalLights[i]);
+    }
+    lightBVH.containing(Vec3(context.point), emitter);
+}
+
+// Renders a tile in two passes. The closest hits of all the camera rays
+// are written to the G-buffer first, with their texture coordinates. The
+// hits are then shaded sorted by material: the texture or color and the
+// mode are chosen once per material, and a texture is read by all of its
+// hits in a row. Reflections are traced right after their hit.
+void Scene::renderDeferred(const RenderJob &job, int x0, int y0, int x1, int y1, GBuffer &gbuffer)
+{
+    const RenderOptions &options = job.options;
+    unsigned int aaFactor = options.aaFactor;
+    unsigned int perPixel = aaFactor * aaFactor;
+    int width = x1 - x0;
+
+    gbuffer.hits.clear();
+    gbuffer.colors.assign(width * (y1 - y0) * perPixel, Color(0.0, 0.0, 0.0));
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            unsigned int pixel = ((y - y0) * width + (x - x0)) * perPixel;
+            for(unsigned int i = 1; i < (aaFactor + 1); i++) {
+                for(unsigned int j = 1; j < (aaFactor + 1); j++) {
+                    Ray ray = primaryRay(job, x, y, i, j);
+                    Hit min_hit(std::numeric_limits<double>::infinity());
+                    Object *obj = closestHit(ray, min_hit);
+                    if (!obj) continue;
+
+                    Vector N = obj->normal(ray, min_hit);
+                    GBuffer::Sample hit;
+                    hit.t = min_hit.t;
+                    hit.nx = N.x;
+                    hit.ny = N.y;
+                    hit.nz = N.z;
+                    hit.u = hit.v = 0;
+                    if (obj->material->texture) texCoords(N, obj->angle, hit.u, hit.v);
+                    hit.lod = textureLevel(ray, min_hit, N, *obj, options, 0);
+                    hit.obj = obj;
+                    hit.sample = pixel + (i - 1) * aaFactor + (j - 1);
+                    gbuffer.hits.push_back(hit);
                 }
             }
-            img(x,y) = totalCol / (float) (aaFactor * aaFactor);
+        }
+    }
+    Stats::count(Stats::PrimaryRays, gbuffer.colors.size());
+    std::sort(gbuffer.hits.begin(), gbuffer.hits.end(), ByMaterial());
+
+    for (unsigned int begin = 0, end; begin < gbuffer.hits.size(); begin = end) {
+        const Material *material = gbuffer.hits[begin].obj->material;
+        for (end = begin + 1; end < gbuffer.hits.size() && gbuffer.hits[end].obj->material == material; end++) { }
+
+        const Image *tex = material->texture;
+        Color base = options.mode == RenderOptions::Phong ? material->color : Color(1.0, 1.0, 1.0);
+        for (unsigned int k = begin; k < end; k++) {
+            const GBuffer::Sample &sample = gbuffer.hits[k];
+            unsigned int pixel = sample.sample / perPixel;
+            unsigned int i = (sample.sample % perPixel) / aaFactor + 1;
+            unsigned int j = sample.sample % aaFactor + 1;
+            Ray ray = primaryRay(job, x0 + pixel % width, y0 + pixel / width, i, j);
+            Hit hit(sample.t);
+            Vector N = Vector(sample.nx, sample.ny, sample.nz).normalized();
+
+            Color col;
+            if (options.mode == RenderOptions::ZBuffer || options.mode == RenderOptions::Normal) {
+                col = shade(ray, hit, N, sample.obj, options, 1, 0, 0, rayStack);
+            } else {
+                reflect(ray, hit, N, sample.obj, options, 1, 0, 0, rayStack);
+                ShadingContext context(ray, hit, N, *sample.obj, options, sample.lod);
+                col = (tex ? texColor(tex, sample.u, sample.v, sample.lod, options) : base) * lightSum(context);
+                col += traceStack(rayStack, options);
+            }
+            gbuffer.colors[sample.sample] = col;
         }
     }
 
-    std::cout << "Rendering ended: " << (std::clock() - tInit) / (double)CLOCKS_PER_SEC << " seconds" << std::endl;
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            unsigned int pixel = ((y - y0) * width + (x - x0)) * perPixel;
+            Color totalCol(0.0, 0.0, 0.0);
+            for (unsigned int k = 0; k < perPixel; k++) {
+                Color col = gbuffer.colors[pixel + k];
+                col.clamp();
+                totalCol += col;
+            }
+            (*job.img)(x,y) = totalCol / (float) perPixel;
+        }
+    }
 }
 
-Color Scene::getTexColor(const Image *tex, Vector N, float angle)
+// Spherical texture coordinates of a normal, with the texture turned by angle.
+// u wraps around, so any angle stays inside the texture.
+void Scene::texCoords(const Vector &N, float angle, float &u, float &v)
 {
-    float u = 1 - (0.5 + (atan2(N.z, N.x) + angle) / (2 * M_PI));
-    float v = 0.5 - asin(N.y) / M_PI;
+    u = 1 - (0.5 + (atan2(N.z, N.x) + angle) / (2 * M_PI));
+    u -= floor(u);
+    v = 0.5 - asin(std::max(-1.0, std::min(1.0, N.y))) / M_PI;
+}
 
+Color Scene::getTexColor(const ShadingContext &context)
+{
+    float u, v;
+    texCoords(context.N, context.angle, u, v);
+    return texColor(context.material->texture, u, v, context.lod, context.options);
+}
+
+// Color of a texture at (u, v) with the filter of the options
+Color Scene::texColor(const Image *tex, float u, float v, float lod, const RenderOptions &options)
+{
+    if(options.textureFilter == RenderOptions::Trilinear) return tex->trilinearAt(u, v, lod);
+    if(options.textureFilter == RenderOptions::Bilinear) return tex->bilinearAt(u, v);
     return tex->colorAt(u, v);
 }
 
+// Mip level of the texture lookup at a hit for trilinear filtering, dist
+// being the distance the ray travelled before its origin. The ray is
+// followed as a cone widening by options.coneSpread per unit of distance.
+// The width of the cone at the hit is stepped on the surface, along the
+// ray (stretched by the slant of the surface) and across it, and the
+// level is picked from the texels between the texture coordinates of the
+// normals at both ends of the longest step. Flat objects keep their
+// normal and are looked up in the full texture.
+float Scene::textureLevel(const Ray &ray, const Hit &hit, const Vector &N, const Object &obj, const RenderOptions &options, float dist)
+{
+    const Image *tex = obj.material->texture;
+    if(!tex || options.textureFilter != RenderOptions::Trilinear) return 0;
+
+    double width = options.coneSpread * (dist + hit.t);
+    if(width <= 0) return 0;
+
+    Vector n = N.normalized();
+    double cosine = fabs(ray.D.dot(n));
+    Vector along = ray.D - ray.D.dot(n) * n;
+    if(along.length() < 1e-6) along = n.cross(fabs(n.x) < 0.9 ? Vector(1, 0, 0) : Vector(0, 1, 0));
+    along = along.normalized();
+    Vector steps[2] = { along * (width / std::max(cosine, 0.1)), n.cross(along) * width };
+
+    float u, v;
+    texCoords(n, obj.angle, u, v);
+    float texels = 0;
+    for(unsigned int i = 0; i < 2; i++)
+    {
+        // the same hit seen from a ray moved by the step
+        Ray moved(ray.O + steps[i], ray.D);
+        float su, sv;
+        texCoords(obj.normal(moved, hit).normalized(), obj.angle, su, sv);
+        float du = fabs(su - u), dv = fabs(sv - v);
+        if(du > 0.5f) du = 1 - du;  // across the seam of the texture
+        texels = std::max(texels, std::max(du * tex->width(), dv * tex->height()));
+    }
+    return texels > 1 ? log2f(texels) : 0;
+}
+
 void Scene::addObject(Object *o)
 {
     objects.push_back(o);
 }
 
+void Scene::buildBVH()
+{
+    PhaseTimer timer(Stats::BuildPhase);
+    bounded.clear();
+    unbounded.clear();
+
+    std::vector<BBox> boxes;
+    for (unsigned int i = 0; i < objects.size(); ++i) {
+        BBox box = objects[i]->bounds();
+        if (box.isFinite()) {
+            bounded.push_back(objects[i]);
+            boxes.push_back(box);
+        } else {
+            unbounded.push_back(objects[i]);
+        }
+    }
+    bvh.build(boxes);
+
+    globalLights.clear();
+    localLights.clear();
+    std::vector<BBox> reach;
+    for (unsigned int i = 0; i < lights.size(); ++i) {
+        if (lights[i]->radius > 0) {
+            Vector r(lights[i]->radius, lights[i]->radius, lights[i]->radius);
+            localLights.push_back(lights[i]);
+            reach.push_back(BBox(lights[i]->position - r, lights[i]->position + r));
+        } else {
+            globalLights.push_back(lights[i]);
+        }
+    }
+    lightBVH.build(reach);
+}
+
 void Scene::addLight(Light *l)
 {
     lights.push_back(l);
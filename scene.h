@@ -18,32 +18,193 @@
 #define SCENE_H_KNBLQLP6
 
 #include <vector>
+#include <atomic>
 #include <math.h>
-#include <ctime>
 #include "triple.h"
 #include "light.h"
 #include "object.h"
 #include "image.h"
 #include "camera.h"
-#include "goochparams.h"
+#include "renderoptions.h"
 #include "material.h"
+#include "bvh.h"
+#include "wavefront.h"
+#include "gbuffer.h"
+#include "arena.h"
 
+// Receives the image after every pass of a progressive render
+class RenderObserver
+{
+public:
+    virtual ~RenderObserver() { }
+
+    // pass goes from 1 to passes, returning false stops the render
+    virtual bool frame(const Image &img, unsigned int pass, unsigned int passes) = 0;
+};
+
+// Buffers of a render that grow with the tile size, the antialiasing and
+// the number of lights. The caller owns them, Scene::prepare sizes them
+// before the render starts and the renders of the same size reuse them,
+// so tracing allocates nothing, like RayStack.
+class RenderBuffers
+{
+public:
+    std::vector<Wavefront> wavefronts;  // one per render thread
+    std::vector<GBuffer> gbuffers;      // one per render thread
+    Image firstSamples;                 // first sample of every pixel with adaptive antialiasing
+};
+
+// Everything the render workers share: the options of the render call,
+// the camera frame and the counter handing out the next tile.
+class RenderJob
+{
+public:
+    static const int tileSize = 16;
+
+    // Progressive renders start with Coarse passes of one sample per
+    // block of pixels, of decreasing size, before the full render.
+    // Adaptive antialiasing renders in two passes: one sample per pixel
+    // first, then the pixels that differ from a neighbour are refined.
+    enum Pass { AllSamples, Coarse, FirstSamples, Refine };
+
+    // first coarse block size, a divisor of tileSize
+    static const int coarseSize = 8;
+
+    Image *img;
+    Camera *cam;
+    RenderOptions options;
+    Pass pass;
+    int blockSize;      // block size of a coarse pass
+    Image *firstSamples;
+    RenderBuffers *buffers;
+
+    float pixSize;
+    Vector xDir, yDir, start;
+    int tilesX, tilesY;
+    std::atomic<int> nextTile;
+};
+
+// What the shading of one hit needs, built once per hit and passed on by
+// reference to every light.
+class ShadingContext
+{
+public:
+    ShadingContext(const Ray &ray, const Hit &hit, const Vector &N, const Object &obj, const RenderOptions &options, float lod)
+        : point(ray.at(hit.t)), N(N), V(-ray.D), material(obj.material), angle(obj.angle), lod(lod), options(options)
+    { }
+
+    Point point;                    // the hit point
+    Vector N;                       // the normal at the hit point
+    Vector V;                       // the view vector
+    const Material *material;
+    float angle;                    // texture rotation of the object
+    float lod;                      // mip level of the texture, for trilinear filtering
+    const RenderOptions &options;
+};
+
+// Rays waiting to be traced, with the weight of their color in the pixel
+// (the product of the ks of the surfaces they bounced off). Every hit
+// pushes at most its reflection, which is popped right away, so a few
+// entries are enough whatever the reflection depth. The distance a ray
+// travelled before its origin widens its cone for texture filtering.
+class RayStack
+{
+public:
+    static const unsigned int capacity = 16;
+
+    class Entry
+    {
+    public:
+        Ray ray;
+        float weight;
+        unsigned int depth;
+        float dist;
+    };
+
+    RayStack() : size(0) { }
+
+    bool empty() const { return size == 0; }
+
+    // false when the stack is full and the ray is dropped
+    bool push(const Ray &ray, float weight, unsigned int depth, float dist)
+    {
+        if (size == capacity) return false;
+        entries[size].ray = ray;
+        entries[size].weight = weight;
+        entries[size].depth = depth;
+        entries[size].dist = dist;
+        size++;
+        return true;
+    }
+
+    const Entry& pop() { return entries[--size]; }
+
+private:
+    Entry entries[capacity];
+    unsigned int size;
+};
 
 class Scene
 {
 private:
+    Arena arena;    // owns the objects, materials, textures and lights
     std::vector<Object*> objects;
     std::vector<Light*> lights;
     Triple eye;
-    Light recursiveReflection(Ray ray, unsigned int depth, unsigned int maxDepth, bool shadows);
-    Color totalColor(const Ray &ray, Hit min_hit, std::vector<Light*> lights, float angle, Material *material, bool shadows, bool reflection, unsigned int mode, GoochParams gp);
-    void phong(Point hit, Point lightPosition, Vector N, Vector V, Material *mat, float &difftIntensity, float &specIntensity);
-    Color getTexColor(const Image *tex, Vector N, float angle);
+
+    // acceleration structure, built by buildBVH() once all objects and lights are added
+    BVH bvh;
+    std::vector<Object*> bounded;       // objects in the BVH, indexed by the BVH primitives
+    std::vector<Object*> unbounded;     // objects without finite bounds, tested linearly
+    Object* closestHit(const Ray &ray, Hit &min_hit);
+    bool occluded(const Ray &ray, double tMax);
+
+    // lights with a radius are found through a BVH over their reach
+    BVH lightBVH;
+    std::vector<Light*> globalLights;   // lights without a radius, shading every hit
+    std::vector<Light*> localLights;    // indexed by the lightBVH primitives
+    class LightVisitor;
+    class LightEmitter;
+    bool lightContribution(const Light &light, const ShadingContext &context, Triple &intensity, double &attenuation);
+    Triple lightIntensity(const Light &light, const ShadingContext &context);
+
+    Color totalColor(const ShadingContext &context);
+    Triple lightSum(const ShadingContext &context);
+    Color albedo(const ShadingContext &context);
+    Color getTexColor(const ShadingContext &context);
+    static Color texColor(const Image *tex, float u, float v, float lod, const RenderOptions &options);
+    static void texCoords(const Vector &N, float angle, float &u, float &v);
+    static float textureLevel(const Ray &ray, const Hit &hit, const Vector &N, const Object &obj, const RenderOptions &options, float dist);
+    Color shade(const Ray &ray, const Hit &min_hit, const Vector &N, const Object *obj, const RenderOptions &options, float weight, unsigned int depth, float dist, RayStack &stack);
+    void reflect(const Ray &ray, const Hit &hit, const Vector &N, const Object *obj, const RenderOptions &options, float weight, unsigned int depth, float dist, RayStack &stack);
+    Color traceStack(RayStack &stack, const RenderOptions &options);
+    void tracePacket(RayPacket &packet, Color *colors, const RenderOptions &options);
+    static unsigned int renderThreads(const RenderOptions &options);
+    void runWorkers(RenderJob &job, unsigned int threads);
+    void renderTiles(RenderJob &job, unsigned int worker);
+    Ray primaryRay(const RenderJob &job, int x, int y, unsigned int i, unsigned int j);
+    Color sample(const RenderJob &job, int x, int y, unsigned int i, unsigned int j);
+    void sampleBlock(const RenderJob &job, int x, int y, unsigned int i, unsigned int j, Color *colors);
+    Color renderPixel(const RenderJob &job, int x, int y);
+    void renderBlock(const RenderJob &job, int x, int y);
+    void renderCoarse(const RenderJob &job, int x0, int y0, int x1, int y1);
+    Color refinePixel(const RenderJob &job, int x, int y);
+    void renderWavefront(const RenderJob &job, int x0, int y0, int x1, int y1, Wavefront &wavefront);
+    void traceShadows(Wavefront &wavefront);
+    void shadeWavefront(const Wavefront::PathHit &pathHit, const RenderOptions &options, Wavefront &wavefront);
+    void renderDeferred(const RenderJob &job, int x0, int y0, int x1, int y1, GBuffer &gbuffer);
 
 public:
-    Color trace(const Ray &ray, unsigned int mode, bool shadows, bool reflection, unsigned int depth, unsigned int maxDepth, GoochParams gp);
-    void render(Image &img, Camera *cam, bool shadows, bool reflection, unsigned int renderType, unsigned int aaFactor, GoochParams gp);
+    static void phong(const Point &hit, const Point &lightPosition, const Vector &N, const Vector &V, const Material *mat, float &difftIntensity, float &specIntensity);
+    Color trace(const Ray &ray, const RenderOptions &options);
+    // sizes the buffers for a render of w x h pixels, does nothing when
+    // they are large enough already
+    void prepare(RenderBuffers &buffers, int w, int h, const RenderOptions &options);
+    bool render(Image &img, Camera *cam, const RenderOptions &options, RenderBuffers &buffers, RenderObserver *observer = NULL);
+    // objects and lights added to the scene are created in its arena
+    Arena& getArena() { return arena; }
     void addObject(Object *o);
+    void buildBVH();
     void addLight(Light *l);
     void setEye(Triple e);
     unsigned int getNumObjects() { return objects.size(); }
@@ -43,10 +43,63 @@ Hit Sphere::intersect(const Ray &ray)
     // If t is negative, ray started inside sphere so clamp t to zero 
     if (t < 0.0f) t = 0.0f; 
 
-    Vector i = ray.O + t * ray.D;
+    return Hit(t);
+}
 
-    Vector N = i - position;
-    N = N.normalized();
+Vector Sphere::normal(const Ray &ray, const Hit &hit) const
+{
+    Vector N = ray.at(hit.t) - position;
+    return N.normalized();
+}
+
+bool Sphere::occluded(const Ray &ray, double tMax)
+{
+    // same test as intersect, without the normal
+    Vector m = ray.O - position;
+    float b = m.dot(ray.D);
+    float c = m.dot(m) - r * r;
+
+    if (c > 0.0f && b > 0.0f) return false;
+    float discr = b*b - c;
+
+    if (discr < 0.0f) return false;
+
+    // a ray starting inside the sphere is blocked right away
+    float t = -b - sqrt(discr);
+    return t < tMax;
+}
 
-    return Hit(t,N);
-}
\ No newline at end of file
+void Sphere::intersectPacket(RayPacket &packet)
+{
+#ifdef __SSE2__
+    // intersect for four rays at once
+    __m128 mx = _mm_sub_ps(_mm_load_ps(packet.ox), _mm_set1_ps(position.x));
+    __m128 my = _mm_sub_ps(_mm_load_ps(packet.oy), _mm_set1_ps(position.y));
+    __m128 mz = _mm_sub_ps(_mm_load_ps(packet.oz), _mm_set1_ps(position.z));
+    __m128 b = packetDot(mx, my, mz, _mm_load_ps(packet.dx), _mm_load_ps(packet.dy), _mm_load_ps(packet.dz));
+    __m128 mm = packetDot(mx, my, mz, mx, my, mz);
+    __m128 c = _mm_sub_ps(mm, _mm_set1_ps(r * r));
+    __m128 discr = _mm_sub_ps(_mm_mul_ps(b, b), c);
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 outsideAway = _mm_and_ps(_mm_cmpgt_ps(c, zero), _mm_cmpgt_ps(b, zero));
+    // discr loses the precision of m . m far from the sphere, grazing rays
+    // are kept by packetEpsilon and checked in double precision by the scene
+    __m128 low = _mm_sub_ps(zero, _mm_mul_ps(mm, _mm_set1_ps(packetEpsilon)));
+    __m128 hit = _mm_andnot_ps(outsideAway, _mm_cmpge_ps(discr, low));
+    if (!_mm_movemask_ps(hit)) return;
+
+    __m128 t = _mm_sub_ps(_mm_sub_ps(zero, b), _mm_sqrt_ps(_mm_max_ps(discr, zero)));
+    t = _mm_max_ps(t, zero);
+
+    packet.update(t, _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_load_ps(packet.t))), this);
+#else
+    Object::intersectPacket(packet);
+#endif
+}
+
+BBox Sphere::bounds() const
+{
+    Vector extent(r, r, r);
+    return BBox(position - extent, position + extent);
+}
@@ -22,9 +22,13 @@
 class Sphere : public Object
 {
 public:
-    Sphere(Point position,double r) : position(position), r(r) { }
+    Sphere(Point position,double r) : Object(Stats::SphereTests), position(position), r(r) { }
 
     virtual Hit intersect(const Ray &ray);
+    virtual Vector normal(const Ray &ray, const Hit &hit) const;
+    virtual bool occluded(const Ray &ray, double tMax);
+    virtual void intersectPacket(RayPacket &packet);
+    virtual BBox bounds() const;
 
     const Point position;
     const double r;
@@ -0,0 +1,138 @@
+//
+//  Framework for a raytracer
+//  File: stats.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "stats.h"
+#include <iomanip>
+#include <mutex>
+
+/************************** Stats **********************************/
+
+thread_local unsigned long long Stats::local[Stats::NumCounters];
+unsigned long long Stats::totals[Stats::NumCounters];
+double Stats::times[Stats::NumPhases];
+
+namespace {
+
+std::mutex totalsMutex;
+
+const char *counterNames[Stats::NumCounters] = {
+    "primary", "reflection", "shadow",
+    "sphere", "triangle", "plane", "quad", "mesh", "other",
+    "meshTriangles", "bvhNodes"
+};
+
+const char *phaseNames[Stats::NumPhases] = {
+    "parse", "textures", "meshes", "build", "render", "encode"
+};
+
+}
+
+void Stats::flush()
+{
+    std::lock_guard<std::mutex> lock(totalsMutex);
+    for (int i = 0; i < NumCounters; i++)
+    {
+        totals[i] += local[i];
+        local[i] = 0;
+    }
+}
+
+void Stats::reset()
+{
+    std::lock_guard<std::mutex> lock(totalsMutex);
+    for (int i = 0; i < NumCounters; i++)
+    {
+        totals[i] = 0;
+        local[i] = 0;
+    }
+    for (int i = 0; i < NumPhases; i++)
+    {
+        times[i] = 0;
+    }
+}
+
+double Stats::mraysPerSecond()
+{
+    double rays = totals[PrimaryRays] + totals[ReflectionRays] + totals[ShadowRays];
+    return times[RenderPhase] > 0 ? rays / times[RenderPhase] / 1e6 : 0;
+}
+
+void Stats::print(std::ostream &out)
+{
+    double total = 0;
+    for (int i = 0; i < NumPhases; i++) total += times[i];
+
+    out << "Statistics:" << std::endl;
+    out << "  rays:     ";
+    for (int i = PrimaryRays; i <= ShadowRays; i++) out << " " << counterNames[i] << " " << totals[i];
+    out << " (" << std::setprecision(3) << mraysPerSecond() << " Mrays/s)" << std::endl;
+    out << "  tests:    ";
+    for (int i = SphereTests; i <= MeshTriangleTests; i++) out << " " << counterNames[i] << " " << totals[i];
+    out << std::endl;
+    out << "  bvh nodes: " << totals[BVHNodes] << std::endl;
+    out << "  seconds:  ";
+    for (int i = 0; i < NumPhases; i++) out << " " << phaseNames[i] << " " << std::setprecision(3) << times[i];
+    out << " total " << total << std::endl;
+}
+
+void Stats::writeJSON(std::ostream &out)
+{
+    double total = 0;
+    for (int i = 0; i < NumPhases; i++) total += times[i];
+
+    out << "{" << std::endl;
+    out << "  \"counters\": {";
+    for (int i = 0; i < NumCounters; i++)
+    {
+        out << (i ? ", " : " ") << "\"" << counterNames[i] << "\": " << totals[i];
+    }
+    out << " }," << std::endl;
+    out << "  \"seconds\": {" << std::setprecision(6);
+    for (int i = 0; i < NumPhases; i++)
+    {
+        out << (i ? ", " : " ") << "\"" << phaseNames[i] << "\": " << times[i];
+    }
+    out << ", \"total\": " << total << " }," << std::endl;
+    out << "  \"mraysPerSecond\": " << mraysPerSecond() << std::endl;
+    out << "}" << std::endl;
+}
+
+/************************** PhaseTimer **********************************/
+
+PhaseTimer *PhaseTimer::current = NULL;
+
+PhaseTimer::PhaseTimer(Stats::Phase phase) : phase(phase), parent(current), start(Clock::now()), paused(0)
+{
+    // the outer phase is paused until this one ends
+    if (parent)
+    {
+        double seconds = std::chrono::duration<double>(start - parent->start).count();
+        Stats::addSeconds(parent->phase, seconds);
+        parent->paused += seconds;
+    }
+    current = this;
+}
+
+PhaseTimer::~PhaseTimer()
+{
+    Stats::addSeconds(phase, std::chrono::duration<double>(Clock::now() - start).count());
+    current = parent;
+    if (parent) parent->start = Clock::now();
+}
+
+double PhaseTimer::elapsed() const
+{
+    return paused + std::chrono::duration<double>(Clock::now() - start).count();
+}
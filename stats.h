@@ -0,0 +1,90 @@
+//
+//  Framework for a raytracer
+//  File: stats.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <ostream>
+
+// Render statistics: ray and intersection counters, and the wall clock time
+// of every phase from reading the scene to writing the image. The counters
+// are kept per thread and only added to the totals by flush(), so the render
+// threads never write to shared memory while tracing.
+class Stats
+{
+public:
+    enum Counter
+    {
+        PrimaryRays, ReflectionRays, ShadowRays,
+        SphereTests, TriangleTests, PlaneTests, QuadTests, MeshTests, OtherTests,
+        MeshTriangleTests, BVHNodes,
+        NumCounters
+    };
+
+    enum Phase
+    {
+        ParsePhase, TexturePhase, MeshPhase, BuildPhase, RenderPhase, EncodePhase,
+        NumPhases
+    };
+
+    static void count(Counter counter, unsigned long long n = 1) { local[counter] += n; }
+
+    // adds the counters of the calling thread to the totals
+    static void flush();
+
+    // clears the totals, the times and the counters of the calling thread
+    static void reset();
+
+    static unsigned long long total(Counter counter) { return totals[counter]; }
+    static double seconds(Phase phase) { return times[phase]; }
+    static void addSeconds(Phase phase, double seconds) { times[phase] += seconds; }
+
+    // rays of all kinds traced per second of rendering, in millions
+    static double mraysPerSecond();
+
+    static void print(std::ostream &out);
+    static void writeJSON(std::ostream &out);
+
+private:
+    static thread_local unsigned long long local[NumCounters];
+    static unsigned long long totals[NumCounters];
+    static double times[NumPhases];
+};
+
+// Times a phase while in scope. Timers nest: the time spent in an inner
+// phase isn't counted in the outer one, so the phases add up to the total.
+// Phases are only timed on the main thread.
+class PhaseTimer
+{
+public:
+    PhaseTimer(Stats::Phase phase);
+    ~PhaseTimer();
+
+    // seconds spent in this phase so far, inner phases excluded
+    double elapsed() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    Stats::Phase phase;
+    PhaseTimer *parent;
+    Clock::time_point start;    // when the phase started or was last resumed
+    double paused;              // time measured before the last inner phase
+
+    static PhaseTimer *current;
+};
+
+#endif /* end of include guard: STATS_H */
@@ -23,38 +23,62 @@
 
 Hit Triangle::intersect(const Ray &ray)
 {
-    // http://www.r-5.org/files/books/computers/algo-list/realtime-3d/Christer_Ericson-Real-Time_Collision_Detection-EN.pdf
-    // section 5.3.4
-
-    Vector pq = ray.D;
-    Vector pa = a - ray.O;
-    Vector pb = b - ray.O;
-    Vector pc = c - ray.O;
-
-    float u = pq.dot(pc.cross(pb));
-    if(u < 0.0f) return Hit::NO_HIT();
-    float v = pq.dot(pa.cross(pc));
-    if(v < 0.0f) return Hit::NO_HIT();
-    float w = pq.dot(pb.cross(pa));
-    if(w < 0.0f) return Hit::NO_HIT();
-
-    float denom = 1.0f / (u + v + w);
-    u *= denom;
-    v *= denom;
-    w *= denom;
-
-    Point i = u*a + v*b + w*c;
-    Vector tv = i - ray.O;
-    float t = tv.length();
-
-    // https://www.khronos.org/opengl/wiki/Calculating_a_Surface_Normal
-
-    Vector ba = b - a;
-    Vector ca = c - a;
-    Vector N;
-    N.x = ba.y * ca.z - ba.z * ca.y;
-    N.y = ba.z * ca.x - ba.x * ca.z;
-    N.z = ba.x * ca.y - ba.y * ca.x;
-
-    return Hit(t,N);
-}
\ No newline at end of file
+    double t, u, v;
+    // the tests are done on the line, reject points behind the origin
+    if(!intersect(ray, a, e1, e2, N, t, u, v) || t < 0.0) return Hit::NO_HIT();
+    return Hit(t, 0, u, v);
+}
+
+Vector Triangle::normal(const Ray &ray, const Hit &hit) const
+{
+    return N;
+}
+
+bool Triangle::occluded(const Ray &ray, double tMax)
+{
+    double t, u, v;
+    return intersect(ray, a, e1, e2, N, t, u, v) && t >= 0.0 && t < tMax;
+}
+
+void Triangle::intersectPacket(RayPacket &packet)
+{
+#ifdef __SSE2__
+    // intersect for four rays at once
+    __m128 dx = _mm_load_ps(packet.dx), dy = _mm_load_ps(packet.dy), dz = _mm_load_ps(packet.dz);
+    __m128 nx = _mm_set1_ps(N.x), ny = _mm_set1_ps(N.y), nz = _mm_set1_ps(N.z);
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 det = _mm_sub_ps(zero, packetDot(dx, dy, dz, nx, ny, nz));
+    __m128 hit = _mm_cmpgt_ps(det, zero);
+    if (!_mm_movemask_ps(hit)) return;
+
+    __m128 sx = _mm_sub_ps(_mm_load_ps(packet.ox), _mm_set1_ps(a.x));
+    __m128 sy = _mm_sub_ps(_mm_load_ps(packet.oy), _mm_set1_ps(a.y));
+    __m128 sz = _mm_sub_ps(_mm_load_ps(packet.oz), _mm_set1_ps(a.z));
+
+    // q = s x D, u = e2 . q, v = -(e1 . q), t = (s . N) / det
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, dz), _mm_mul_ps(sz, dy));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, dx), _mm_mul_ps(sx, dz));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, dy), _mm_mul_ps(sy, dx));
+    __m128 u = packetDot(_mm_set1_ps(e2.x), _mm_set1_ps(e2.y), _mm_set1_ps(e2.z), qx, qy, qz);
+    __m128 v = _mm_sub_ps(zero, packetDot(_mm_set1_ps(e1.x), _mm_set1_ps(e1.y), _mm_set1_ps(e1.z), qx, qy, qz));
+    __m128 t = _mm_div_ps(packetDot(sx, sy, sz, nx, ny, nz), det);
+
+    // the edges are widened by packetEpsilon so single precision can't
+    // lose a hit, the scene checks the hit it keeps in double precision
+    __m128 pad = _mm_mul_ps(det, _mm_set1_ps(packetEpsilon));
+    __m128 low = _mm_sub_ps(zero, pad);
+    hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(u, low), _mm_cmpge_ps(v, low)));
+    hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmple_ps(_mm_add_ps(u, v), _mm_add_ps(det, pad)), _mm_cmpge_ps(t, zero)));
+    packet.update(t, _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_load_ps(packet.t))), this);
+#else
+    Object::intersectPacket(packet);
+#endif
+}
+
+BBox Triangle::bounds() const
+{
+    BBox box(a, b);
+    box.extend(c);
+    return box;
+}
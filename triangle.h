@@ -23,11 +23,48 @@
 class Triangle : public Object
 {
 public:
-    Triangle(Point a, Point b, Point c) : a(a), b(b), c(c) { }
+    Triangle(Point a, Point b, Point c)
+        : Object(Stats::TriangleTests), a(a), b(b), c(c), e1(b - a), e2(c - a), N(e1.cross(e2))
+    { }
 
     virtual Hit intersect(const Ray &ray);
+    virtual Vector normal(const Ray &ray, const Hit &hit) const;
+    virtual bool occluded(const Ray &ray, double tMax);
+    virtual void intersectPacket(RayPacket &packet);
+    virtual BBox bounds() const;
+
+    // Moller-Trumbore test of the triangle v0, v0 + e1, v0 + e2 with face
+    // normal N = e1 x e2, seen from its front. Sets the distance t and the
+    // barycentric coordinates u, v of v0 + e1 and v0 + e2 on a hit. The
+    // three cross products of the test only depend on the triangle and are
+    // folded into N, a ray costs one cross product and four dot products.
+    static bool intersect(const Ray &ray, const Point &v0, const Vector &e1, const Vector &e2, const Vector &N,
+                          double &t, double &u, double &v);
 
     const Point a, b, c;
+    const Vector e1, e2;    // edges b - a and c - a
+    const Vector N;         // face normal, not normalized
 };
 
+inline bool Triangle::intersect(const Ray &ray, const Point &v0, const Vector &e1, const Vector &e2, const Vector &N,
+                                double &t, double &u, double &v)
+{
+    // det = e1 . (D x e2), negative for the back of the triangle
+    double det = -ray.D.dot(N);
+    if(!(det > 0.0)) return false;
+
+    Vector s = ray.O - v0;
+    Vector q = s.cross(ray.D);
+    u = e2.dot(q);
+    if(u < 0.0) return false;
+    v = -e1.dot(q);
+    if(v < 0.0 || u + v > det) return false;
+
+    double invDet = 1.0 / det;
+    t = s.dot(N) * invDet;
+    u *= invDet;
+    v *= invDet;
+    return true;
+}
+
 #endif /* end of include guard: TRIANGLE_H */
@@ -0,0 +1,138 @@
+//
+//  Framework for a raytracer
+//  File: triangleblock.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef TRIANGLEBLOCK_H
+#define TRIANGLEBLOCK_H
+
+#include "vec3.h"
+
+#if defined(__SSE2__) && !defined(RAYTRACER_DOUBLE)
+#include <emmintrin.h>
+#define TRIANGLEBLOCK_SSE
+#endif
+
+// Four mesh triangles precomputed for Moller-Trumbore and stored as
+// structure of arrays, so one ray is tested against the four of them with
+// one SIMD kernel. Unused lanes have null edges and are never hit.
+class TriangleBlock
+{
+public:
+    static const unsigned int size = 4;
+    static const unsigned int none = ~0u;
+
+    TriangleBlock()
+    {
+        for (unsigned int i = 0; i < size; i++)
+        {
+            v0x[i] = v0y[i] = v0z[i] = 0;
+            e1x[i] = e1y[i] = e1z[i] = 0;
+            e2x[i] = e2y[i] = e2z[i] = 0;
+            nx[i] = ny[i] = nz[i] = 0;
+            triangle[i] = none;
+        }
+    }
+
+    // a, b, c: vertices, n: shading normal, index: triangle in the mesh
+    void set(unsigned int lane, const Vec3 &a, const Vec3 &b, const Vec3 &c, const Vec3 &n, unsigned int index)
+    {
+        Vec3 e1 = b - a;
+        Vec3 e2 = c - a;
+        v0x[lane] = a.x; v0y[lane] = a.y; v0z[lane] = a.z;
+        e1x[lane] = e1.x; e1y[lane] = e1.y; e1z[lane] = e1.z;
+        e2x[lane] = e2.x; e2y[lane] = e2.y; e2z[lane] = e2.z;
+        nx[lane] = n.x; ny[lane] = n.y; nz[lane] = n.z;
+        triangle[lane] = index;
+    }
+
+    // Lane mask of the triangles hit before tMax, with their distances in t.
+    // Only front faces are hit (counter clockwise seen from the ray origin),
+    // like Triangle::intersect.
+    int intersect(const Vec3 &O, const Vec3 &D, real tMax, real *t) const;
+
+    real v0x[size] __attribute__((aligned(16)));
+    real v0y[size] __attribute__((aligned(16)));
+    real v0z[size] __attribute__((aligned(16)));
+    real e1x[size] __attribute__((aligned(16)));
+    real e1y[size] __attribute__((aligned(16)));
+    real e1z[size] __attribute__((aligned(16)));
+    real e2x[size] __attribute__((aligned(16)));
+    real e2y[size] __attribute__((aligned(16)));
+    real e2z[size] __attribute__((aligned(16)));
+    real nx[size] __attribute__((aligned(16)));
+    real ny[size] __attribute__((aligned(16)));
+    real nz[size] __attribute__((aligned(16)));
+    unsigned int triangle[size];
+};
+
+inline int TriangleBlock::intersect(const Vec3 &O, const Vec3 &D, real tMax, real *t) const
+{
+#ifdef TRIANGLEBLOCK_SSE
+    __m128 dx = _mm_set1_ps(D.x), dy = _mm_set1_ps(D.y), dz = _mm_set1_ps(D.z);
+    __m128 ax = _mm_load_ps(e1x), ay = _mm_load_ps(e1y), az = _mm_load_ps(e1z);
+    __m128 bx = _mm_load_ps(e2x), by = _mm_load_ps(e2y), bz = _mm_load_ps(e2z);
+
+    // p = D x e2, det = e1 . p
+    __m128 px = _mm_sub_ps(_mm_mul_ps(dy, bz), _mm_mul_ps(dz, by));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(dz, bx), _mm_mul_ps(dx, bz));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, by), _mm_mul_ps(dy, bx));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, px), _mm_mul_ps(ay, py)), _mm_mul_ps(az, pz));
+    __m128 zero = _mm_setzero_ps();
+    __m128 hit = _mm_cmpgt_ps(det, zero);
+    if (!_mm_movemask_ps(hit)) return 0;
+    __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    // s = O - v0, u = (s . p) / det
+    __m128 sx = _mm_sub_ps(_mm_set1_ps(O.x), _mm_load_ps(v0x));
+    __m128 sy = _mm_sub_ps(_mm_set1_ps(O.y), _mm_load_ps(v0y));
+    __m128 sz = _mm_sub_ps(_mm_set1_ps(O.z), _mm_load_ps(v0z));
+    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+
+    // q = s x e1, v = (D . q) / det, t = (e2 . q) / det
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, az), _mm_mul_ps(sz, ay));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, ax), _mm_mul_ps(sx, az));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, ay), _mm_mul_ps(sy, ax));
+    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+    __m128 tHit = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(bx, qx), _mm_mul_ps(by, qy)), _mm_mul_ps(bz, qz)), invDet);
+
+    hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+    hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(tHit, zero), _mm_cmplt_ps(tHit, _mm_set1_ps(tMax))));
+
+    _mm_storeu_ps(t, tHit);
+    return _mm_movemask_ps(hit);
+#else
+    int mask = 0;
+    for (unsigned int i = 0; i < size; i++)
+    {
+        Vec3 e1(e1x[i], e1y[i], e1z[i]);
+        Vec3 e2(e2x[i], e2y[i], e2z[i]);
+        Vec3 p = D.cross(e2);
+        real det = e1.dot(p);
+        if (!(det > 0)) continue;
+        real invDet = 1 / det;
+
+        Vec3 s = O - Vec3(v0x[i], v0y[i], v0z[i]);
+        real u = s.dot(p) * invDet;
+        Vec3 q = s.cross(e1);
+        real v = D.dot(q) * invDet;
+        t[i] = e2.dot(q) * invDet;
+
+        if (u >= 0 && v >= 0 && u + v <= 1 && t[i] >= 0 && t[i] < tMax) mask |= 1 << i;
+    }
+    return mask;
+#endif
+}
+
+#endif /* end of include guard: TRIANGLEBLOCK_H */
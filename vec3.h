@@ -0,0 +1,89 @@
+//
+//  Framework for a raytracer
+//  File: vec3.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef VEC3_H
+#define VEC3_H
+
+#include <cmath>
+#include <limits>
+#include "triple.h"
+
+// Precision of the intersection code. Scene loading and shading always use
+// Triple (double), build with "make PRECISION=double" to also intersect in
+// double precision.
+#ifdef RAYTRACER_DOUBLE
+typedef double real;
+#else
+typedef float real;
+#endif
+
+// Compact vector for the data touched by every ray: BVH nodes, mesh
+// vertices and the rays during traversal. Padded to four components so it
+// fills exactly one SSE register in single precision.
+class Vec3
+{
+public:
+    Vec3() : x(0), y(0), z(0), w(0) { }
+
+    Vec3(real X, real Y, real Z) : x(X), y(Y), z(Z), w(0) { }
+
+    explicit Vec3(const Triple &t) : x(t.x), y(t.y), z(t.z), w(0) { }
+
+    Triple triple() const { return Triple(x, y, z); }
+
+    Vec3 operator+(const Vec3 &v) const { return Vec3(x + v.x, y + v.y, z + v.z); }
+    Vec3 operator-(const Vec3 &v) const { return Vec3(x - v.x, y - v.y, z - v.z); }
+    Vec3 operator*(real f) const { return Vec3(x * f, y * f, z * f); }
+    friend Vec3 operator*(real f, const Vec3 &v) { return Vec3(f * v.x, f * v.y, f * v.z); }
+
+    real operator[](int i) const { return (&x)[i]; }
+    real& operator[](int i) { return (&x)[i]; }
+
+    real dot(const Vec3 &v) const { return x * v.x + y * v.y + z * v.z; }
+
+    Vec3 cross(const Vec3 &v) const
+    {
+        return Vec3(y * v.z - z * v.y,
+                    z * v.x - x * v.z,
+                    x * v.y - y * v.x);
+    }
+
+    Vec3 inverse() const { return Vec3(1 / x, 1 / y, 1 / z); }
+
+    // Conversions that never shrink a box when rounding to real
+    static Vec3 roundDown(const Triple &t)
+    {
+        Vec3 v(t);
+        for (int i = 0; i < 3; i++)
+        {
+            if (v[i] > t.data[i]) v[i] = std::nextafter(v[i], -std::numeric_limits<real>::infinity());
+        }
+        return v;
+    }
+
+    static Vec3 roundUp(const Triple &t)
+    {
+        Vec3 v(t);
+        for (int i = 0; i < 3; i++)
+        {
+            if (v[i] < t.data[i]) v[i] = std::nextafter(v[i], std::numeric_limits<real>::infinity());
+        }
+        return v;
+    }
+
+    real x, y, z, w;
+} __attribute__((aligned(4 * sizeof(real))));
+
+#endif /* end of include guard: VEC3_H */
@@ -0,0 +1,96 @@
+//
+//  Framework for a raytracer
+//  File: wavefront.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Bernard Lupiac
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include <vector>
+#include "triple.h"
+#include "light.h"
+
+class Object;
+
+// Buffers of the wavefront mode, where a tile is traced one stage at a time
+// over all of its rays: intersect every ray, sort the hits by material,
+// shade them, then trace the shadow rays and start over with the
+// reflections. A render thread keeps one set and reuses it for every tile.
+class Wavefront
+{
+public:
+    // a ray of the stream and the AA sample it adds to
+    class PathRay
+    {
+    public:
+        PathRay(const Ray &ray, float weight, unsigned int depth, float dist, unsigned int sample)
+            : ray(ray), weight(weight), depth(depth), dist(dist), sample(sample)
+        { }
+
+        Ray ray;
+        float weight;       // contribution to the sample
+        unsigned int depth; // number of bounces
+        float dist;         // distance travelled before the origin, see RayStack
+        unsigned int sample;
+    };
+
+    // the closest hit of rays[ray]
+    class PathHit
+    {
+    public:
+        PathHit(const Hit &hit, const Object *obj, unsigned int ray)
+            : hit(hit), obj(obj), ray(ray)
+        { }
+
+        Hit hit;
+        const Object *obj;
+        unsigned int ray;
+    };
+
+    // the weighted color of a light at a hit, added to the sample when
+    // nothing blocks the ray
+    class ShadowRay
+    {
+    public:
+        ShadowRay(const Ray &ray, double tMax, const Color &color, unsigned int sample)
+            : ray(ray), tMax(tMax), color(color), sample(sample)
+        { }
+
+        Ray ray;
+        double tMax;
+        Color color;
+        unsigned int sample;
+    };
+
+    // shadow rays queued at most, the queue is traced when it is full
+    static const unsigned int maxShadows = 1024;
+
+    // makes room for a tile of the given number of camera rays: every hit
+    // queues at most one reflection
+    void reserve(unsigned int numRays)
+    {
+        rays.reserve(numRays);
+        reflections.reserve(numRays);
+        hits.reserve(numRays);
+        shadows.reserve(maxShadows);
+        samples.reserve(numRays);
+    }
+
+    std::vector<PathRay> rays;          // rays of the current stage
+    std::vector<PathRay> reflections;   // rays of the next stage
+    std::vector<PathHit> hits;
+    std::vector<ShadowRay> shadows;
+    std::vector<Color> samples;         // color of every AA sample of the tile
+};
+
+#endif /* end of include guard: WAVEFRONT_H */